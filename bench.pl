@@ -0,0 +1,104 @@
+#!/usr/bin/perl -w
+
+# Run user/bench under QEMU and compare its results with a
+# baseline; "make bench" runs this.
+#
+#   perl bench.pl [-t timeout] [-r tolerance] baseline out "qemu cmd" "bench args"
+#
+# Boots the kernel with the given QEMU command line, waits for
+# the shell's prompt, types "bench args", and collects the
+# "BENCH name value unit" lines it prints into out. Then, for
+# each result also in baseline, prints the change, flagging
+# as a regression any that is worse by more than tolerance
+# percent (default 10): lower for a rate (unit ending in
+# "/s"), higher for a time. Exits 1 if there were
+# regressions. If baseline does not exist, out is copied to
+# it, to compare later runs against.
+
+use strict;
+use IPC::Open2;
+
+my $timeout = 600;
+my $tolerance = 10;
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my $opt = shift;
+    if ($opt eq "-t") { $timeout = shift; }
+    elsif ($opt eq "-r") { $tolerance = shift; }
+    else { die "bench.pl: unknown option $opt\n"; }
+}
+die "usage: perl bench.pl [-t timeout] [-r tolerance] baseline out \"qemu cmd\" \"bench args\"\n"
+    unless @ARGV == 4;
+my ($baseline, $out, $qemu, $args) = @ARGV;
+
+# Read from QEMU until the console output matches $re, and
+# return what was read.
+my $console = "";
+sub expect {
+    my ($fh, $re) = @_;
+    my $buf;
+    while ($console !~ $re) {
+        my $n = sysread($fh, $buf, 4096);
+        die "bench.pl: QEMU exited\n" unless $n;
+        print STDERR $buf;
+        $console .= $buf;
+    }
+    my $got = $console;
+    $console = "";
+    return $got;
+}
+
+my ($from, $to);
+my $pid = open2($from, $to, $qemu);
+local $SIG{ALRM} = sub { kill 'TERM', $pid; die "bench.pl: timed out after ${timeout}s\n"; };
+alarm $timeout;
+
+expect($from, qr/\$ $/);
+print $to "bench $args\n";
+$to->flush();
+my $output = expect($from, qr/\n\$ $/);
+alarm 0;
+
+# Ctrl-A x quits QEMU.
+print $to "\x01x";
+close($to);
+waitpid($pid, 0);
+
+my @results = grep { /^BENCH / } split(/\r?\n/, $output);
+die "bench.pl: no results\n" unless @results;
+open(my $fh, ">", $out) or die "bench.pl: $out: $!\n";
+print $fh map { "$_\n" } @results;
+close($fh);
+
+if (! -e $baseline) {
+    open($fh, ">", $baseline) or die "bench.pl: $baseline: $!\n";
+    print $fh map { "$_\n" } @results;
+    close($fh);
+    print "bench.pl: no baseline; saved these results as $baseline\n";
+    exit 0;
+}
+
+my %base;
+open($fh, "<", $baseline) or die "bench.pl: $baseline: $!\n";
+while (<$fh>) {
+    my (undef, $name, $value) = split;
+    $base{$name} = $value if defined $value;
+}
+close($fh);
+
+my $regressions = 0;
+printf "%-24s %12s %12s %8s\n", "benchmark", "baseline", "now", "change";
+foreach (@results) {
+    my (undef, $name, $value, $unit) = split;
+    next unless exists $base{$name} && $base{$name} > 0;
+    my $change = ($value - $base{$name}) * 100 / $base{$name};
+    # how much worse, in percent.
+    my $worse = $unit =~ m{/s$} ? -$change : $change;
+    my $flag = "";
+    if ($worse > $tolerance) {
+        $flag = " REGRESSION";
+        $regressions++;
+    }
+    printf "%-24s %12d %12d %+7.1f%% %s%s\n", $name, $base{$name}, $value, $change, $unit, $flag;
+}
+print "$regressions regressions (tolerance $tolerance%)\n";
+exit($regressions ? 1 : 0);
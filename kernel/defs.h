@@ -4,10 +4,12 @@ struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct shminfo;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vmcount;
 
 // bio.c
 void            binit(void);
@@ -33,6 +35,12 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filevmsplice(struct file*, uint64, int n);
+
+// futex.c
+void            futexinit(void);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
 
 // fs.c
 void            fsinit(int);
@@ -50,8 +58,10 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+int             breadi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
+int             writeiskip(struct inode*, int, uint64, uint, uint, uint64);
 void            itrunc(struct inode*);
 
 // ramdisk.c
@@ -63,6 +73,9 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            kref(void *);
+int             krefcnt(void *);
+int             kfreepages(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -70,24 +83,54 @@ void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// pagecache.c
+void            pcinit(void);
+uint64          pcget(struct inode*, uint);
+int             pcread(struct inode*, int, uint64, uint, uint);
+void            pcsync(struct inode*, uint, uint, uint64);
+void            pcdrop(struct inode*);
+int             pcwriteback(struct file*, uint, uint64);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             pipewrite(struct pipe*, uint64, int, int);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+extern int      profiling;
+extern int      profmult;
+void            profinit(void);
+void            profsample(void);
+int             prof(int, uint64, int);
+
+// timer.c
+void            timerqinit(void);
+int             timerintr(void);
+void            timerbusy(void);
+void            timeridle(void);
+void            timerkick(int);
+void            timerwake(int);
+int             sleepfor(uint64);
+
+// trace.c
+extern int      tracemask;
+void            traceinit(void);
+void            tracerecord(int, uint64, uint64);
+int             trace(int, uint64, int);
+
 // proc.c
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+int             growproc(int, uint64*);
 void            proc_mapstacks(pagetable_t);
-pagetable_t     proc_pagetable(struct proc *);
+pagetable_t     proc_pagetable(struct proc *, struct vmcount *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
 int             killed(struct proc*);
@@ -102,6 +145,12 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+int             clone(uint64, uint64, uint64);
+int             join(int);
+struct proc*    procleader(struct proc*);
+int             wakeupn(void*, int);
+int             shminfo(int, uint64);
+int             sysstat(int, int, uint64);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
@@ -114,9 +163,14 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initqlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstat(int, uint64, int);
+int             lockstat_class(char*, int);
+void            lockstat_acquired(int, uint64, uint64);
+void            lockstat_released(int, uint64);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -142,10 +196,7 @@ int             fetchaddr(uint64, uint64*);
 void            syscall();
 
 // trap.c
-extern uint     ticks;
-void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
 void            usertrapret(void);
 
 // uart.c
@@ -156,25 +207,35 @@ void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
-uint64          map_shared_pages(struct proc* src_proc, struct proc* dst_proc, uint64 src_va, uint64 size);
-uint64          unmap_shared_pages(struct proc* p, uint64 addr, uint64 size);
+uint64          map_shared_pages(struct proc* src_proc, struct proc* dst_proc, uint64 src_va, uint64 size, int prot);
+uint64          unmap_shared_pages(struct proc* p, uint64 addr, uint64 size, struct file **fp);
+void            vmaunmapall(struct proc*, pagetable_t);
+int             vmacopy(struct proc*, struct proc*);
+int             vmaprotect(struct proc*, uint64, uint64, int);
+void            vmainfo(struct proc*, struct shminfo*);
+uint64          vmammap(struct proc*, uint64*, int, struct file*, uint64, int, int, int);
+void            vmaflush(struct proc*, uint64, uint64);
+void            vmaclose(struct proc*);
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
-int             mappages(pagetable_t, uint64, uint64, uint64, int);
-pagetable_t     uvmcreate(void);
-void            uvmfirst(pagetable_t, uchar *, uint);
-uint64          uvmalloc(pagetable_t, uint64, uint64, int);
-uint64          uvmdealloc(pagetable_t, uint64, uint64);
-int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             mappages(pagetable_t, uint64, uint64, uint64, int, struct vmcount *);
+pagetable_t     uvmcreate(struct vmcount *);
+void            uvmfirst(pagetable_t, uchar *, uint, struct vmcount *);
+uint64          uvmalloc(pagetable_t, uint64, uint64, int, struct vmcount *);
+uint64          uvmdealloc(pagetable_t, uint64, uint64, struct vmcount *);
+int             uvmcopy(pagetable_t, pagetable_t, uint64, struct vmcount *);
 void            uvmfree(pagetable_t, uint64);
-void            uvmunmap(pagetable_t, uint64, uint64, int);
+void            uvmunmap(pagetable_t, uint64, uint64, int, struct vmcount *);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
+int             uvmcow(pagetable_t, uint64);
+uint64          uvmcowref(pagetable_t, uint64);
+int             uvmcowmap(pagetable_t, uint64, uint64);
 
 // plic.c
 void            plicinit(void);
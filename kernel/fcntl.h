@@ -3,3 +3,10 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+#define PROT_NONE  0x0
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+
+#define MAP_SHARED  0x01
+#define MAP_PRIVATE 0x02
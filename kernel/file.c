@@ -140,7 +140,7 @@ filewrite(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, addr, n, 0);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
@@ -180,3 +180,14 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Splice user pages into pipe f: whole page-aligned pages
+// are passed by reference rather than copied.
+// addr is a user virtual address.
+int
+filevmsplice(struct file *f, uint64 addr, int n)
+{
+  if(f->writable == 0 || f->type != FD_PIPE)
+    return -1;
+  return pipewrite(f->pipe, addr, n, 1);
+}
+
@@ -450,6 +450,7 @@ itrunc(struct inode *ip)
 
   ip->size = 0;
   iupdate(ip);
+  pcdrop(ip);
 }
 
 // Copy stat information from inode.
@@ -468,17 +469,38 @@ stati(struct inode *ip, struct stat *st)
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
+// A file's data comes from the page cache, and from the
+// buffer cache only if the page cache is out of room.
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  int r, r1;
 
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
 
+  r = 0;
+  if(ip->type == T_FILE && (r = pcread(ip, user_dst, dst, off, n)) < 0)
+    return -1;
+  if(r < n){
+    if((r1 = breadi(ip, user_dst, dst + r, off + r, n - r)) < 0)
+      return -1;
+    r += r1;
+  }
+  return r;
+}
+
+// Read data from inode through the buffer cache, for readi()
+// and to fill the page cache. off and n lie within the file.
+// Caller must hold ip->lock.
+int
+breadi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m;
+  struct buf *bp;
+
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
     uint addr = bmap(ip, off/BSIZE);
     if(addr == 0)
@@ -504,6 +526,15 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 // there was an error of some kind.
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  return writeiskip(ip, user_src, src, off, n, 0);
+}
+
+// writei(), but leave the cached page whose frame is skip
+// alone: pcwriteback() writes from that frame, and copying the
+// data back into it would undo stores made to it meanwhile.
+int
+writeiskip(struct inode *ip, int user_src, uint64 src, uint off, uint n, uint64 skip)
 {
   uint tot, m;
   struct buf *bp;
@@ -530,6 +561,9 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
   if(off > ip->size)
     ip->size = off;
 
+  // keep pages that mmap() has cached up to date.
+  pcsync(ip, off - tot, tot, skip);
+
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
   // block to ip->addrs[].
@@ -656,7 +690,7 @@ namex(char *path, int nameiparent, char *name)
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
   else
-    ip = idup(myproc()->cwd);
+    ip = idup(procleader(myproc())->cwd);
 
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
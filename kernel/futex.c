@@ -0,0 +1,98 @@
+// Futexes: sleep until a user memory word changes.
+//
+// A waiter is keyed by the physical address of the word, so
+// processes that map the same page, for example with
+// map_shared_pages(), wait on and wake the same futex even if
+// it sits at different virtual addresses in each of them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NFUTEXLOCK 16   // futexes hash onto these locks
+
+struct spinlock futexlock[NFUTEXLOCK];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEXLOCK; i++)
+    initlock(&futexlock[i], "futex");
+}
+
+// The kernel address of the aligned user word at va,
+// or 0 if it is not mapped.
+static int*
+futexword(uint64 va)
+{
+  pagetable_t pagetable = myproc()->pagetable;
+  pte_t *pte;
+  uint64 pa;
+
+  if(va % sizeof(int) != 0 || va >= MAXVA)
+    return 0;
+  // the key must be the frame that stores to the word go to,
+  // so a copy-on-write page gets its own copy now rather than
+  // at the waker's first store, which would move the word.
+  if((pte = walk(pagetable, va, 0)) != 0 && (*pte & PTE_COW) &&
+     uvmcow(pagetable, va) < 0)
+    return 0;
+  if((pa = walkaddr(pagetable, PGROUNDDOWN(va))) == 0)
+    return 0;
+  return (int*)(pa + (va - PGROUNDDOWN(va)));
+}
+
+static struct spinlock*
+futexhash(int *w)
+{
+  return &futexlock[((uint64)w / sizeof(int)) % NFUTEXLOCK];
+}
+
+// Sleep on the word at va if it still holds expected.
+// Returns 0 after a wakeup, 1 if the word had changed,
+// -1 on a bad address or if killed.
+int
+futexwait(uint64 va, int expected)
+{
+  struct spinlock *lk;
+  int *w;
+
+  if((w = futexword(va)) == 0)
+    return -1;
+  lk = futexhash(w);
+  acquire(lk);
+  // futexwake() takes lk, so a waker that has changed the word
+  // either sees us asleep or runs before we look at it.
+  if(__atomic_load_n(w, __ATOMIC_RELAXED) != expected){
+    release(lk);
+    return 1;
+  }
+  if(killed(myproc())){
+    release(lk);
+    return -1;
+  }
+  sleep(w, lk);
+  release(lk);
+  return 0;
+}
+
+// Wake at most n processes waiting on the word at va.
+// Returns how many were woken, or -1 on a bad address.
+int
+futexwake(uint64 va, int n)
+{
+  struct spinlock *lk;
+  int *w, r;
+
+  if((w = futexword(va)) == 0)
+    return -1;
+  lk = futexhash(w);
+  acquire(lk);
+  r = wakeupn(w, n);
+  release(lk);
+  return r;
+}
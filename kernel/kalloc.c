@@ -8,6 +8,7 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "trace.h"
 
 void freerange(void *pa_start, void *pa_end);
 
@@ -21,12 +22,21 @@ struct run {
 struct {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;
 } kmem;
 
+// Reference counts for pages handed out by kalloc(), so that
+// a page can be mapped in more than one place (pipe pages,
+// copy-on-write). kalloc() sets the count to 1, kref() adds
+// one, and kfree() only frees the page when it drops to 0.
+static int pageref[(PHYSTOP - KERNBASE) / PGSIZE];
+
+#define PAGEREF(pa) pageref[((uint64)(pa) - KERNBASE) / PGSIZE]
+
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
+  initqlock(&kmem.lock, "kmem");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,22 +45,33 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    PAGEREF(p) = 1;
     kfree(p);
+  }
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the page of physical memory pointed
+// at by pa, which normally should have been returned by a
+// call to kalloc(), and free it if that was the last one.
+// (The exception is when initializing the allocator; see
+// kinit above.)
 void
 kfree(void *pa)
 {
   struct run *r;
+  int ref;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  ref = __sync_sub_and_fetch(&PAGEREF(pa), 1);
+  if(ref < 0)
+    panic("kfree: ref");
+  if(ref > 0)
+    return;
+  TRACE(TR_KFREE, (uint64)pa, 0);
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
@@ -59,6 +80,7 @@ kfree(void *pa)
   acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   release(&kmem.lock);
 }
 
@@ -72,11 +94,39 @@ kalloc(void)
 
   acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.nfree--;
+  }
   release(&kmem.lock);
 
-  if(r)
+  if(r){
     memset((char*)r, 5, PGSIZE); // fill with junk
+    PAGEREF(r) = 1;
+    TRACE(TR_KALLOC, (uint64)r, 0);
+  }
   return (void*)r;
 }
+
+// Add a reference to a page returned by kalloc().
+void
+kref(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kref");
+  __sync_fetch_and_add(&PAGEREF(pa), 1);
+}
+
+// Return the number of references to a page.
+int
+krefcnt(void *pa)
+{
+  return __atomic_load_n(&PAGEREF(pa), __ATOMIC_RELAXED);
+}
+
+// Return the number of free pages.
+int
+kfreepages(void)
+{
+  return __atomic_load_n(&kmem.nfree, __ATOMIC_RELAXED);
+}
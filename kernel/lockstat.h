@@ -0,0 +1,21 @@
+// Lock contention statistics, collected per lock name
+// (all "proc" locks share one entry, and so on) when the
+// kernel is built with LOCKSTAT=1, and read by lockstat().
+
+#define NLOCKCLASS  32  // maximum number of distinct lock names
+#define NLSHIST     16  // buckets in the hold-time histogram
+
+// lockstat() operations.
+#define LS_READ     0   // copy out the statistics
+#define LS_RESET    1   // zero all counters
+
+struct lockstat {
+  char name[16];          // lock name passed to initlock()
+  int sleep;              // 1 if a sleep-lock
+  uint64 nacquire;        // number of acquisitions
+  uint64 ncontended;      // acquisitions that found the lock held
+  uint64 nspin;           // spin iterations (sleeps, for sleep-locks)
+  uint64 waittime;        // total time ticks spent waiting
+  uint64 maxwait;         // longest single wait, in time ticks
+  uint64 hold[NLSHIST];   // hold[i] counts holds of 2^i..2^(i+1)-1 time ticks
+};
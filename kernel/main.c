@@ -20,13 +20,17 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
-    trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pcinit();        // mmap page cache
+    profinit();      // sampling profiler
+    traceinit();     // event tracing
+    timerqinit();    // one-shot timers
+    futexinit();     // futex wait queues
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -62,6 +62,17 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   shared mappings, from SHMBASE up to SHMTOP
+//   THREADTF (trapframes of threads made by clone())
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// a thread shares its process's page table, so its trapframe
+// goes in a slot of its own, indexed by its place in proc[].
+#define THREADTF(i) (TRAPFRAME - ((i)+1)*PGSIZE)
+
+// map_shared_pages() places mappings in [SHMBASE, SHMTOP),
+// below the THREADTF slots; the heap may not grow past SHMBASE.
+#define SHMTOP (TRAPFRAME - NPROC*PGSIZE)
+#define SHMBASE (MAXVA / 2)
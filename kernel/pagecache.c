@@ -0,0 +1,246 @@
+// Page cache.
+//
+// Whole pages of file data, for read(), exec() and mmap().
+// The buffer cache is left to directories and other metadata,
+// and to the data blocks on their way to and from the disk.
+// Each cached page is a frame from kalloc(), holding the
+// file's bytes at a page-aligned offset and zeros past the
+// end of the file. The cache keeps one reference to the frame
+// and every mapping of it another, so that all processes
+// mapping the same page of a file share one frame.
+//
+// Writes go through the log as before, so the cache holds no
+// dirty data of its own: it is a copy of what the buffer
+// cache and disk hold, plus stores to shared mappings that
+// have not been written back yet.
+//
+// Interface:
+// * pcget() returns a page's frame, reading it in if needed.
+// * readi() calls pcread() to copy file data out of the cache.
+// * writei() calls pcsync() so that write() updates cached
+//   pages, and itrunc() calls pcdrop() to forget them.
+// * pcwriteback() writes a mapped page back to its file.
+//
+// Callers of pcget(), pcsync() and pcdrop() hold the inode's
+// lock, so only one of them at a time deals with a given
+// file's pages. pcache.lock protects the table.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+#define NPCHASH 61   // hash buckets, by file and page number
+
+struct pcpage {
+  uint dev;
+  uint inum;
+  uint pgno;            // page number within the file
+  uint64 pa;            // the frame, or 0 if the entry is free
+  uint used;            // pcache.clock when last returned by pcget()
+  struct pcpage *next;  // in hash bucket
+};
+
+struct {
+  struct spinlock lock;
+  struct pcpage page[NPCACHE];
+  struct pcpage *hash[NPCHASH];
+  uint clock;
+} pcache;
+
+#define PCHASH(dev, inum, pgno) (((dev) * 31 + (inum) * 17 + (pgno)) % NPCHASH)
+
+void
+pcinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+}
+
+static struct pcpage*
+pclookup(struct inode *ip, uint pgno)
+{
+  struct pcpage *pg;
+
+  for(pg = pcache.hash[PCHASH(ip->dev, ip->inum, pgno)]; pg; pg = pg->next)
+    if(pg->dev == ip->dev && pg->inum == ip->inum && pg->pgno == pgno)
+      return pg;
+  return 0;
+}
+
+// Take pg, which holds a frame, out of its hash bucket and
+// return the frame, for the caller to kfree().
+static uint64
+pcunhash(struct pcpage *pg)
+{
+  struct pcpage **pp;
+  uint64 pa;
+
+  for(pp = &pcache.hash[PCHASH(pg->dev, pg->inum, pg->pgno)]; *pp != pg; pp = &(*pp)->next)
+    ;
+  *pp = pg->next;
+  pa = pg->pa;
+  pg->pa = 0;
+  return pa;
+}
+
+// Return the frame holding page pgno of ip, with a reference
+// for the caller, or 0 if out of memory or if every cached
+// page is mapped. Caller holds ip->lock.
+uint64
+pcget(struct inode *ip, uint pgno)
+{
+  struct pcpage *pg, *victim, **bucket;
+  uint off, n;
+  uint64 old;
+  char *mem;
+
+  acquire(&pcache.lock);
+  if((pg = pclookup(ip, pgno)) != 0){
+    pg->used = ++pcache.clock;
+    kref((void*)pg->pa);
+    release(&pcache.lock);
+    return pg->pa;
+  }
+  release(&pcache.lock);
+
+  if((mem = kalloc()) == 0)
+    return 0;
+  memset(mem, 0, PGSIZE);
+  off = pgno * PGSIZE;
+  if(off < ip->size){
+    n = min(PGSIZE, ip->size - off);
+    if(breadi(ip, 0, (uint64)mem, off, n) != n){
+      kfree(mem);
+      return 0;
+    }
+  }
+
+  // replace the least recently used page that nothing maps;
+  // with only the cache's reference, nothing else can take one.
+  acquire(&pcache.lock);
+  victim = 0;
+  for(pg = pcache.page; pg < &pcache.page[NPCACHE]; pg++){
+    if(pg->pa == 0){
+      victim = pg;
+      break;
+    }
+    if(krefcnt((void*)pg->pa) == 1 && (victim == 0 || pg->used < victim->used))
+      victim = pg;
+  }
+  if(victim == 0){
+    release(&pcache.lock);
+    kfree(mem);
+    return 0;
+  }
+  old = victim->pa ? pcunhash(victim) : 0;
+  victim->dev = ip->dev;
+  victim->inum = ip->inum;
+  victim->pgno = pgno;
+  victim->pa = (uint64)mem;
+  victim->used = ++pcache.clock;
+  bucket = &pcache.hash[PCHASH(ip->dev, ip->inum, pgno)];
+  victim->next = *bucket;
+  *bucket = victim;
+  kref(mem);
+  release(&pcache.lock);
+  if(old)
+    kfree((void*)old);
+  return (uint64)mem;
+}
+
+// Copy n bytes of ip's data at off, which lie within the
+// file, to dst through the cache. Returns the number of bytes
+// copied, which is short if the cache has no room, or -1 if
+// dst is bad. Caller holds ip->lock.
+int
+pcread(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m;
+  uint64 pa;
+
+  for(tot = 0; tot < n; tot += m, off += m, dst += m){
+    if((pa = pcget(ip, off / PGSIZE)) == 0)
+      break;
+    m = min(n - tot, PGSIZE - off % PGSIZE);
+    if(either_copyout(user_dst, dst, (char*)pa + off % PGSIZE, m) == -1){
+      kfree((void*)pa);
+      return -1;
+    }
+    kfree((void*)pa);
+  }
+  return tot;
+}
+
+// writei() has written n bytes at off; copy them into any
+// cached pages they fall in, except the one whose frame is
+// skip, if not 0. Caller holds ip->lock.
+void
+pcsync(struct inode *ip, uint off, uint n, uint64 skip)
+{
+  struct pcpage *pg;
+  uint a, m;
+  uint64 pa;
+
+  for(a = off; a < off + n; a += m){
+    m = min(off + n - a, PGSIZE - a % PGSIZE);
+    acquire(&pcache.lock);
+    if((pg = pclookup(ip, a / PGSIZE)) == 0 || pg->pa == skip){
+      release(&pcache.lock);
+      continue;
+    }
+    pa = pg->pa;
+    kref((void*)pa);
+    release(&pcache.lock);
+    breadi(ip, 0, pa + a % PGSIZE, a, m);
+    kfree((void*)pa);
+  }
+}
+
+// ip is being truncated: forget its pages. Frames that are
+// still mapped stay with their mappings. Caller holds ip->lock.
+void
+pcdrop(struct inode *ip)
+{
+  struct pcpage *pg;
+
+  acquire(&pcache.lock);
+  for(pg = pcache.page; pg < &pcache.page[NPCACHE]; pg++){
+    if(pg->pa && pg->dev == ip->dev && pg->inum == ip->inum)
+      kfree((void*)pcunhash(pg));
+  }
+  release(&pcache.lock);
+}
+
+// Write the page at pa back to f's file at off, as much of
+// it as lies within the file. Like filewrite(), write a few
+// blocks per transaction. Returns 0, or -1 on error.
+int
+pcwriteback(struct file *f, uint off, uint64 pa)
+{
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  uint i, n1;
+  int r;
+
+  for(i = 0; i < PGSIZE; i += n1){
+    begin_op();
+    ilock(f->ip);
+    if(off + i >= f->ip->size){
+      iunlock(f->ip);
+      end_op();
+      break;
+    }
+    n1 = min(min(PGSIZE - i, max), f->ip->size - off - i);
+    r = writeiskip(f->ip, 0, pa + i, off + i, n1, pa);
+    iunlock(f->ip);
+    end_op();
+    if(r != n1)
+      return -1;
+  }
+  return 0;
+}
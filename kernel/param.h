@@ -1,4 +1,6 @@
 #define NPROC        64  // maximum number of processes
+#define NVMA         16  // shared mappings per process
+#define NPCACHE     128  // pages in the mmap page cache
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
@@ -9,5 +11,8 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define FSSIZE       4000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define TIMEFREQ     10000000  // time CSR ticks per second in qemu
+#define NSPERTIME    (1000000000/TIMEFREQ)  // nanoseconds per time CSR tick
+#define TICKINTERVAL 1000000   // time CSR ticks per uptime() tick and time slice
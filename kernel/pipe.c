@@ -8,7 +8,26 @@
 #include "sleeplock.h"
 #include "file.h"
 
-#define PIPESIZE 512
+#define PIPESIZE 2048 // a power of two, so nread/nwrite may wrap
+#define PIPEPAGES 16  // whole pages queued by vmsplice(), also a power of two
+
+// At most one reader and one writer use a pipe at a time:
+// each claims its end for the whole system call (see
+// pipeclaim()). The writer alone then advances nwrite, and
+// the reader alone nread, so bytes move without pi->lock, in
+// runs as long as the free (or filled) part of the ring.
+// pi->lock is taken only to sleep, and by the other side to
+// wake a sleeper that has announced itself in rsleep/wsleep.
+//
+// vmsplice() queues whole user pages by reference in pages[]
+// instead of copying them into data[]. Each entry records the
+// value of nwrite when it was queued: the page comes after
+// that many ring bytes and before the rest. The writer alone
+// advances pgwrite and the reader alone pgread, as for the ring.
+struct pipepage {
+  uint64 pa;      // physical page, holding one reference
+  uint pos;       // nwrite when the page was queued
+};
 
 struct pipe {
   struct spinlock lock;
@@ -17,6 +36,15 @@ struct pipe {
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int reading;    // a reader has claimed the read end
+  int writing;    // a writer has claimed the write end
+  int claimwait;  // processes sleeping in pipeclaim()
+  int rsleep;     // the reader is sleeping for data
+  int wsleep;     // the writer is sleeping for space
+  struct pipepage pages[PIPEPAGES];
+  uint pgread;    // number of pages read
+  uint pgwrite;   // number of pages written
+  uint pgoff;     // bytes already read from pages[pgread]
 };
 
 int
@@ -34,6 +62,14 @@ pipealloc(struct file **f0, struct file **f1)
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
+  pi->reading = 0;
+  pi->writing = 0;
+  pi->claimwait = 0;
+  pi->rsleep = 0;
+  pi->wsleep = 0;
+  pi->pgread = 0;
+  pi->pgwrite = 0;
+  pi->pgoff = 0;
   initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -68,63 +104,241 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    for(; pi->pgread != pi->pgwrite; pi->pgread++)
+      kfree((void*)pi->pages[pi->pgread % PIPEPAGES].pa);
     kfree((char*)pi);
   } else
     release(&pi->lock);
 }
 
+// Claim one end of the pipe (&pi->reading or &pi->writing).
+// Uncontended, this is a single atomic swap.
+static int
+pipeclaim(struct pipe *pi, int *end)
+{
+  if(__sync_lock_test_and_set(end, 1) == 0)
+    return 0;
+
+  acquire(&pi->lock);
+  pi->claimwait++;
+  __sync_synchronize();
+  while(__sync_lock_test_and_set(end, 1) != 0){
+    if(killed(myproc())){
+      pi->claimwait--;
+      release(&pi->lock);
+      return -1;
+    }
+    sleep(end, &pi->lock);
+  }
+  pi->claimwait--;
+  release(&pi->lock);
+  return 0;
+}
+
+static void
+pipeunclaim(struct pipe *pi, int *end)
+{
+  __sync_lock_release(end);
+  __sync_synchronize();
+  if(__atomic_load_n(&pi->claimwait, __ATOMIC_RELAXED)){
+    acquire(&pi->lock);
+    wakeup(end);
+    release(&pi->lock);
+  }
+}
+
+// Wake the other side if it has said it is sleeping on chan.
+// The fence pairs with the one a sleeper executes between
+// setting *sleeping and re-checking nread/nwrite, so either
+// we see the flag or it sees our update.
+static void
+pipewake(struct pipe *pi, int *sleeping, void *chan)
+{
+  __sync_synchronize();
+  if(__atomic_load_n(sleeping, __ATOMIC_RELAXED)){
+    acquire(&pi->lock);
+    wakeup(chan);
+    release(&pi->lock);
+  }
+}
+
+// Is there no room for the writer? page says whether it
+// wants a slot in pages[] or space in data[].
+static int
+pipefull(struct pipe *pi, int page)
+{
+  if(page)
+    return pi->pgwrite == pi->pgread + PIPEPAGES;
+  return pi->nwrite == pi->nread + PIPESIZE;
+}
+
+// Write n bytes from user address addr. If gift is set, the
+// page-aligned whole pages among them are queued by reference,
+// and stay copy-on-write in the writer until the reader is done.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, uint64 addr, int n, int gift)
 {
-  int i = 0;
+  int i = 0, page;
+  uint nw, pgw, off, m;
+  uint64 pa;
   struct proc *pr = myproc();
 
-  acquire(&pi->lock);
+  if(pipeclaim(pi, &pi->writing) < 0)
+    return -1;
+
+  nw = pi->nwrite;
+  pgw = pi->pgwrite;
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
-      release(&pi->lock);
+      pipeunclaim(pi, &pi->writing);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
-      sleep(&pi->nwrite, &pi->lock);
-    } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
-        break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+    page = gift && (addr + i) % PGSIZE == 0 && n - i >= PGSIZE;
+    if(page)
+      m = PIPEPAGES - (pgw - __atomic_load_n(&pi->pgread, __ATOMIC_ACQUIRE));
+    else
+      m = PIPESIZE - (nw - __atomic_load_n(&pi->nread, __ATOMIC_ACQUIRE));
+    if(m == 0){
+      acquire(&pi->lock);
+      pi->wsleep = 1;
+      __sync_synchronize();
+      if(pipefull(pi, page) && pi->readopen) //DOC: pipewrite-full
+        sleep(&pi->nwrite, &pi->lock);
+      pi->wsleep = 0;
+      release(&pi->lock);
+      continue;
+    }
+
+    if(page && (pa = uvmcowref(pr->pagetable, addr + i)) != 0){
+      pi->pages[pgw % PIPEPAGES].pa = pa;
+      pi->pages[pgw % PIPEPAGES].pos = nw;
+      pgw++;
+      i += PGSIZE;
+      __atomic_store_n(&pi->pgwrite, pgw, __ATOMIC_RELEASE);
+      pipewake(pi, &pi->rsleep, &pi->nread);
+      continue;
+    }
+    if(page){
+      // not a private page (e.g. shared memory); copy the rest.
+      gift = 0;
+      continue;
     }
+
+    // copy one contiguous run, stopping at a page boundary
+    // when gifting so that the next page can be queued.
+    off = nw % PIPESIZE;
+    if(m > PIPESIZE - off)
+      m = PIPESIZE - off;
+    if(m > n - i)
+      m = n - i;
+    if(gift && m > PGSIZE - (addr + i) % PGSIZE)
+      m = PGSIZE - (addr + i) % PGSIZE;
+    if(copyin(pr->pagetable, &pi->data[off], addr + i, m) == -1)
+      break;
+    nw += m;
+    i += m;
+    __atomic_store_n(&pi->nwrite, nw, __ATOMIC_RELEASE);
+    pipewake(pi, &pi->rsleep, &pi->nread);
   }
-  wakeup(&pi->nread);
-  release(&pi->lock);
+  pipeunclaim(pi, &pi->writing);
 
   return i;
 }
 
+// Read from the head page of pages[]. A whole page read to a
+// page-aligned private user page is remapped there copy-on-write
+// instead of copied. Returns the number of bytes read, or -1.
+static int
+pipereadpage(struct pipe *pi, struct proc *pr, uint64 addr, int n)
+{
+  struct pipepage *pg = &pi->pages[pi->pgread % PIPEPAGES];
+  int m;
+
+  if(pi->pgoff == 0 && addr % PGSIZE == 0 && n >= PGSIZE &&
+     uvmcowmap(pr->pagetable, addr, pg->pa) == 0){
+    // the mapping took over the pipe's reference.
+    m = PGSIZE;
+  } else {
+    m = PGSIZE - pi->pgoff;
+    if(m > n)
+      m = n;
+    if(copyout(pr->pagetable, addr, (char*)pg->pa + pi->pgoff, m) == -1)
+      return -1;
+    pi->pgoff += m;
+    if(pi->pgoff < PGSIZE)
+      return m;
+    kfree((void*)pg->pa);
+  }
+  pi->pgoff = 0;
+  __atomic_store_n(&pi->pgread, pi->pgread + 1, __ATOMIC_RELEASE);
+  return m;
+}
+
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i = 0, m;
+  uint nr, nw, pgw, off, avail;
+  struct pipepage *pg;
   struct proc *pr = myproc();
-  char ch;
 
-  acquire(&pi->lock);
-  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+  if(pipeclaim(pi, &pi->reading) < 0)
+    return -1;
+
+  nr = pi->nread;
+  for(;;){  //DOC: pipe-empty
+    // read writeopen before pgwrite, and pgwrite before nwrite:
+    // nothing written before the writer closed is missed, and
+    // nw covers the bytes ahead of every page up to pgw, so a
+    // page is never seen without the bytes that come before it.
+    int open = __atomic_load_n(&pi->writeopen, __ATOMIC_ACQUIRE);
+    pgw = __atomic_load_n(&pi->pgwrite, __ATOMIC_ACQUIRE);
+    nw = __atomic_load_n(&pi->nwrite, __ATOMIC_ACQUIRE);
+    if(nw != nr || pgw != pi->pgread || !open)
+      break;
     if(killed(pr)){
-      release(&pi->lock);
+      pipeunclaim(pi, &pi->reading);
       return -1;
     }
-    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+    acquire(&pi->lock);
+    pi->rsleep = 1;
+    __sync_synchronize();
+    if(pi->nwrite == nr && pi->pgwrite == pi->pgread && pi->writeopen)
+      sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+    pi->rsleep = 0;
+    release(&pi->lock);
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
+
+  while(i < n){  //DOC: piperead-copy
+    // bytes in data[] before the next queued page, if any.
+    avail = nw - nr;
+    if(pgw != pi->pgread){
+      pg = &pi->pages[pi->pgread % PIPEPAGES];
+      if(pg->pos == nr){
+        if((m = pipereadpage(pi, pr, addr + i, n - i)) < 0)
+          break;
+        i += m;
+        continue;
+      }
+      if(pg->pos - nr < avail)
+        avail = pg->pos - nr;
+    }
+    if(avail == 0)
       break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+    off = nr % PIPESIZE;
+    m = avail;
+    if(m > PIPESIZE - off)
+      m = PIPESIZE - off;
+    if(m > n - i)
+      m = n - i;
+    if(copyout(pr->pagetable, addr + i, &pi->data[off], m) == -1)
       break;
+    nr += m;
+    i += m;
+    __atomic_store_n(&pi->nread, nr, __ATOMIC_RELEASE);
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
-  release(&pi->lock);
+  pipeunclaim(pi, &pi->reading);
+  pipewake(pi, &pi->wsleep, &pi->nwrite);  //DOC: piperead-wakeup
+
   return i;
 }
@@ -5,6 +5,9 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "shminfo.h"
+#include "trace.h"
+#include "sysstat.h"
 
 struct cpu cpus[NCPU];
 
@@ -49,8 +52,10 @@ procinit(void)
 {
   struct proc *p;
   
+  if(sizeof(struct sysstats) > PGSIZE)
+    panic("procinit: sysstats");
   initlock(&pid_lock, "nextpid");
-  initlock(&wait_lock, "wait_lock");
+  initqlock(&wait_lock, "wait_lock");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -132,8 +137,17 @@ found:
     return 0;
   }
 
+  // And a page of system call counts.
+  if((p->sysstat = (struct sysstats *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  memset(p->sysstat, 0, sizeof(*p->sysstat));
+
   // An empty user page table.
-  p->pagetable = proc_pagetable(p);
+  p->tfva = TRAPFRAME;
+  p->pagetable = proc_pagetable(p, &p->vm);
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
@@ -149,18 +163,55 @@ found:
   return p;
 }
 
+// Add the system call counts in from to those in to.
+static void
+addstats(struct sysstat *to, struct sysstat *from)
+{
+  int i, j;
+
+  for(i = 0; i < NSYSCALL; i++){
+    to[i].count += from[i].count;
+    to[i].time += from[i].time;
+    for(j = 0; j < NSSHIST; j++)
+      to[i].hist[j] += from[i].hist[j];
+  }
+}
+
 // free a proc structure and the data hanging from it,
 // including user pages.
 // p->lock must be held.
 static void
 freeproc(struct proc *p)
 {
+  struct proc *me = myproc();
+
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
+  if(p->sysstat){
+    // the caller is reaping p: keep p's counts.
+    if(me && me != p){
+      if(p->leader)
+        addstats(me->sysstat->self, p->sysstat->self);
+      else
+        addstats(me->sysstat->children, p->sysstat->self);
+      addstats(me->sysstat->children, p->sysstat->children);
+    }
+    kfree((void*)p->sysstat);
+  }
+  p->sysstat = 0;
+  if(p->pagetable && p->leader){
+    // a thread: drop just its trapframe from the shared table.
+    uvmunmap(p->pagetable, p->tfva, 1, 0, 0);
+    p->leader->nthread--;
+  } else if(p->pagetable){
+    vmaunmapall(p, p->pagetable);
     proc_freepagetable(p->pagetable, p->sz);
+  }
   p->pagetable = 0;
+  memset(&p->vm, 0, sizeof(p->vm));
+  p->leader = 0;
+  p->tfva = 0;
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -172,14 +223,14 @@ freeproc(struct proc *p)
 }
 
 // Create a user page table for a given process, with no user memory,
-// but with trampoline and trapframe pages.
+// but with trampoline and trapframe pages, counted in *vc.
 pagetable_t
-proc_pagetable(struct proc *p)
+proc_pagetable(struct proc *p, struct vmcount *vc)
 {
   pagetable_t pagetable;
 
   // An empty page table.
-  pagetable = uvmcreate();
+  pagetable = uvmcreate(vc);
   if(pagetable == 0)
     return 0;
 
@@ -188,7 +239,7 @@ proc_pagetable(struct proc *p)
   // only the supervisor uses it, on the way
   // to/from user space, so not PTE_U.
   if(mappages(pagetable, TRAMPOLINE, PGSIZE,
-              (uint64)trampoline, PTE_R | PTE_X) < 0){
+              (uint64)trampoline, PTE_R | PTE_X, vc) < 0){
     uvmfree(pagetable, 0);
     return 0;
   }
@@ -196,8 +247,8 @@ proc_pagetable(struct proc *p)
   // map the trapframe page just below the trampoline page, for
   // trampoline.S.
   if(mappages(pagetable, TRAPFRAME, PGSIZE,
-              (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
-    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+              (uint64)(p->trapframe), PTE_R | PTE_W, vc) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0, vc);
     uvmfree(pagetable, 0);
     return 0;
   }
@@ -210,8 +261,8 @@ proc_pagetable(struct proc *p)
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
-  uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, TRAMPOLINE, 1, 0, 0);
+  uvmunmap(pagetable, TRAPFRAME, 1, 0, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -239,7 +290,7 @@ userinit(void)
   
   // allocate one user page and copy initcode's instructions
   // and data into it.
-  uvmfirst(p->pagetable, initcode, sizeof(initcode));
+  uvmfirst(p->pagetable, initcode, sizeof(initcode), &p->vm);
   p->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
@@ -254,23 +305,42 @@ userinit(void)
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
+// The process whose memory, size and open files p uses:
+// p itself, unless p is a thread made by clone().
+struct proc*
+procleader(struct proc *p)
+{
+  return p->leader ? p->leader : p;
+}
+
+// Grow or shrink user memory by n bytes, setting *oldsz
+// to the size before.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
   uint64 sz;
-  struct proc *p = myproc();
+  struct proc *p = procleader(myproc());
+  // threads share the size, so they change it under the
+  // process's lock. only the process itself can create a
+  // thread, so without any it need not lock.
+  int locked = p != myproc() || p->nthread > 0;
 
-  sz = p->sz;
+  if(locked)
+    acquire(&p->lock);
+  sz = *oldsz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(sz + n > SHMBASE || (sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W, &p->vm)) == 0) {
+      if(locked)
+        release(&p->lock);
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    sz = uvmdealloc(p->pagetable, sz, sz + n, &p->vm);
   }
   p->sz = sz;
+  if(locked)
+    release(&p->lock);
   return 0;
 }
 
@@ -282,6 +352,7 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *lp = procleader(p);
 
   // Allocate process.
   if((np = allocproc()) == 0){
@@ -289,12 +360,22 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  if(uvmcopy(lp->pagetable, np->pagetable, lp->sz, &np->vm) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->sz = lp->sz;
+
+  // Shared mappings stay shared.
+  acquire(&lp->lock);
+  if(vmacopy(lp, np) < 0){
+    release(&lp->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  release(&lp->lock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -304,9 +385,9 @@ fork(void)
 
   // increment reference counts on open file descriptors.
   for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if(lp->ofile[i])
+      np->ofile[i] = filedup(lp->ofile[i]);
+  np->cwd = idup(lp->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -321,10 +402,138 @@ fork(void)
   acquire(&np->lock);
   np->state = RUNNABLE;
   release(&np->lock);
+  timerwake(1);
+
+  return pid;
+}
+
+// Create a thread that shares the caller's memory, size and
+// open files, and starts running fn(arg) on the given user
+// stack. Returns its pid, which join() takes.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *lp = procleader(p);
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // use the process's page table instead of a new one, with
+  // the thread's trapframe mapped in a slot of its own.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+  np->tfva = THREADTF(np - proc);
+  acquire(&lp->lock);
+  if(mappages(lp->pagetable, np->tfva, PGSIZE,
+              (uint64)(np->trapframe), PTE_R | PTE_W, &lp->vm) < 0){
+    release(&lp->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  release(&lp->lock);
+  np->pagetable = lp->pagetable;
+  np->leader = lp;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = lp;
+  lp->nthread++;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+  timerwake(1);
 
   return pid;
 }
 
+// Wait for the thread tid, which must share the caller's
+// memory, to exit, and free it. Returns tid, or -1.
+int
+join(int tid)
+{
+  struct proc *pp;
+  int found;
+  struct proc *p = myproc();
+  struct proc *lp = procleader(p);
+
+  acquire(&wait_lock);
+
+  for(;;){
+    found = 0;
+    for(pp = proc; pp < &proc[NPROC]; pp++){
+      if(pp->leader == lp && pp->pid == tid && pp != p){
+        acquire(&pp->lock);
+        found = 1;
+        if(pp->state == ZOMBIE){
+          freeproc(pp);
+          release(&pp->lock);
+          release(&wait_lock);
+          return tid;
+        }
+        release(&pp->lock);
+      }
+    }
+
+    if(!found || killed(p)){
+      release(&wait_lock);
+      return -1;
+    }
+
+    // exiting threads wake their process.
+    sleep(lp, &wait_lock);
+  }
+}
+
+// Kill p's threads and wait for them to exit, then free
+// them, so that p's memory can go.
+static void
+reapthreads(struct proc *p)
+{
+  struct proc *pp;
+  int alive;
+
+  acquire(&wait_lock);
+  for(;;){
+    alive = 0;
+    for(pp = proc; pp < &proc[NPROC]; pp++){
+      if(pp->leader == p){
+        acquire(&pp->lock);
+        if(pp->state == ZOMBIE){
+          freeproc(pp);
+        } else {
+          alive = 1;
+          pp->killed = 1;
+          if(pp->state == SLEEPING)
+            pp->state = RUNNABLE;
+        }
+        release(&pp->lock);
+      }
+    }
+    if(!alive)
+      break;
+    sleep(p, &wait_lock);
+  }
+  release(&wait_lock);
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -351,26 +560,36 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  // A thread leaves the files and memory to its process;
+  // a process first takes its threads down with it.
+  if(p->leader == 0){
+    reapthreads(p);
+
+    // Write back file mappings and close their files.
+    vmaclose(p);
+
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(p->ofile[fd]){
+        struct file *f = p->ofile[fd];
+        fileclose(f);
+        p->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+    begin_op();
+    iput(p->cwd);
+    end_op();
+    p->cwd = 0;
+  }
 
   acquire(&wait_lock);
 
   // Give any children to init.
   reparent(p);
 
-  // Parent might be sleeping in wait().
+  // Parent might be sleeping in wait(), or a thread's
+  // process in join() or reapthreads().
   wakeup(p->parent);
   
   acquire(&p->lock);
@@ -400,7 +619,7 @@ wait(uint64 addr)
     // Scan through table looking for exited children.
     havekids = 0;
     for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
+      if(pp->parent == p && pp->leader == 0){
         // make sure the child isn't still in exit() or swtch().
         acquire(&pp->lock);
 
@@ -447,11 +666,14 @@ scheduler(void)
   struct proc *p;
   struct cpu *c = mycpu();
   
+  int found;
+
   c->proc = 0;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
+    found = 0;
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
       if(p->state == RUNNABLE) {
@@ -460,14 +682,35 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        timerbusy();
+        TRACE(TR_SWITCHIN, p->pid, 0);
         swtch(&c->context, &p->context);
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
+        found = 1;
       }
       release(&p->lock);
     }
+    if(found == 0){
+      // nothing to run. stop the time-slice interrupt, after
+      // which a wakeup() on another CPU kicks this one. but a
+      // process may have been made runnable after we passed
+      // it, so look again with interrupts off. if there is
+      // still nothing, wait: wfi ends when an interrupt is
+      // pending, even with them off, and the intr_on() at the
+      // top of the loop then takes it.
+      intr_off();
+      timeridle();
+      for(p = proc; p < &proc[NPROC] && found == 0; p++){
+        acquire(&p->lock);
+        found = p->state == RUNNABLE;
+        release(&p->lock);
+      }
+      if(found == 0)
+        asm volatile("wfi");
+    }
   }
 }
 
@@ -493,6 +736,7 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  TRACE(TR_SWITCHOUT, p->pid, p->state);
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -567,16 +811,44 @@ void
 wakeup(void *chan)
 {
   struct proc *p;
+  int woken = 0;
 
   for(p = proc; p < &proc[NPROC]; p++) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        woken++;
       }
       release(&p->lock);
     }
   }
+  if(woken)
+    timerwake(woken);
+}
+
+// Wake up at most n processes sleeping on chan,
+// and return how many were woken.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
+{
+  struct proc *p;
+  int woken = 0;
+
+  for(p = proc; p < &proc[NPROC] && woken < n; p++) {
+    if(p != myproc()){
+      acquire(&p->lock);
+      if(p->state == SLEEPING && p->chan == chan) {
+        p->state = RUNNABLE;
+        woken++;
+      }
+      release(&p->lock);
+    }
+  }
+  if(woken)
+    timerwake(woken);
+  return woken;
 }
 
 // Kill the process with the given pid.
@@ -594,6 +866,9 @@ kill(int pid)
       if(p->state == SLEEPING){
         // Wake process from sleep().
         p->state = RUNNABLE;
+        release(&p->lock);
+        timerwake(1);
+        return 0;
       }
       release(&p->lock);
       return 0;
@@ -652,6 +927,91 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// shminfo() system call: describe the memory of the process
+// with the smallest pid >= pid, leaving threads out, in the
+// struct shminfo at user address addr. Returns its pid, or
+// -1 if there is no such process, so that pid+1 finds the
+// next one.
+int
+shminfo(int pid, uint64 addr)
+{
+  struct proc *p;
+  struct shminfo si;
+  int best;
+
+  for(;;){
+    best = -1;
+    for(p = proc; p < &proc[NPROC]; p++){
+      acquire(&p->lock);
+      if(p->leader == 0 && p->pid >= pid && (best < 0 || p->pid < best) &&
+         (p->state == SLEEPING || p->state == RUNNABLE || p->state == RUNNING))
+        best = p->pid;
+      release(&p->lock);
+    }
+    if(best < 0)
+      return -1;
+
+    // it may have exited since; if so, look again.
+    for(p = proc; p < &proc[NPROC]; p++){
+      acquire(&p->lock);
+      if(p->pid == best && p->leader == 0 &&
+         (p->state == SLEEPING || p->state == RUNNABLE || p->state == RUNNING))
+        break;
+      release(&p->lock);
+    }
+    if(p < &proc[NPROC])
+      break;
+  }
+
+  memset(&si, 0, sizeof(si));
+  si.pid = p->pid;
+  si.nthread = p->nthread;
+  safestrcpy(si.name, p->name, sizeof(si.name));
+  vmainfo(p, &si);
+  release(&p->lock);
+  si.freepages = kfreepages();
+
+  if(copyout(myproc()->pagetable, addr, (char*)&si, sizeof(si)) < 0)
+    return -1;
+  return si.pid;
+}
+
+// sysstat() system call: copy the system call counts of
+// process pid, or of the caller if pid is 0, to the
+// NSYSCALL structs at user address addr. who is SS_SELF for
+// its own calls, SS_CHILDREN for its reaped children's.
+int
+sysstat(int pid, int who, uint64 addr)
+{
+  struct proc *p;
+  struct sysstat *st;
+  int r;
+
+  if(who != SS_SELF && who != SS_CHILDREN)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((st = (struct sysstat *)kalloc()) == 0)
+    return -1;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->sysstat)
+      break;
+    release(&p->lock);
+  }
+  if(p == &proc[NPROC]){
+    kfree((void*)st);
+    return -1;
+  }
+  memmove(st, who == SS_SELF ? p->sysstat->self : p->sysstat->children,
+          NSYSCALL * sizeof(*st));
+  release(&p->lock);
+
+  r = copyout(myproc()->pagetable, addr, (char*)st, NSYSCALL * sizeof(*st));
+  kfree((void*)st);
+  return r;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -678,6 +1038,10 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    // threads share their process's page table and its counts.
+    if(p->pagetable && p->leader == 0)
+      printf(" rss %dK (%dK shared) peak %dK pt %d", (p->vm.private + p->vm.shared) * (PGSIZE / 1024),
+             p->vm.shared * (PGSIZE / 1024), p->vm.peak * (PGSIZE / 1024), p->vm.ptpages);
     printf("\n");
   }
 }
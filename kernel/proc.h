@@ -24,6 +24,10 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int subtick;                // Periodic timer interrupts in this time slice.
+  uint64 nextintr;            // r_time() of the next periodic timer interrupt, or ~0 if idle.
+  pagetable_t upagetable;     // User page table while in user mode, else 0; see vmchanged().
+  uint64 utraps;              // Traps from user mode.
 };
 
 extern struct cpu cpus[NCPU];
@@ -82,6 +86,36 @@ struct trapframe {
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
+// A user page translation remembered by copyin()/copyout()
+// for the rest of the current system call.
+#define NUCACHE 4
+struct ucache {
+  uint64 va;                   // page-aligned user address
+  uint64 pa;
+  uint64 gen;                  // vmgen when looked up; 0 if empty
+  uint flags;                  // PTE flags
+};
+
+// A range of shared mappings, in [SHMBASE, SHMTOP).
+struct vma {
+  uint64 start;
+  uint64 end;
+  int maxprot;    // PROT_ bits mprotect() may grant
+  struct file *f; // mapped file, for mmap(), or 0
+  uint64 off;     // offset in f of start
+  int flags;      // MAP_SHARED or MAP_PRIVATE, for a file
+};
+
+// Pages an address space maps below SHMTOP, which are user
+// memory rather than trapframes or the trampoline, and the
+// page-table pages it uses, kept by mappages() and uvmunmap().
+struct vmcount {
+  int private;    // pages not in shared mappings
+  int shared;     // pages in shared mappings
+  int ptpages;    // page-table pages
+  int peak;       // most private+shared there have been
+};
+
 struct proc {
   struct spinlock lock;
 
@@ -92,16 +126,24 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  int nthread;                 // Threads sharing this process's memory
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // user virtual address of trapframe
+  struct proc *leader;         // If a thread, the process it belongs to
+  struct vma vma[NVMA];        // Shared mappings, sorted by address
+  int nvma;                    // Number of entries in vma[]
+  struct vmcount vm;           // Pages pagetable maps
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct ucache ucache[NUCACHE]; // translations cached by copyin/copyout
+  struct sysstats *sysstat;    // system call counts, for sysstat()
 };
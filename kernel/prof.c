@@ -0,0 +1,120 @@
+// Sampling profiler.
+//
+// While it is on, each periodic timer interrupt on each busy
+// CPU records the interrupted pc, and the process that was
+// running, in that CPU's ring of samples, where
+// prof(PROF_READ) finds them. The interrupts then come
+// PROFMULT times as often, and timerintr() ends a time slice
+// only at every PROFMULT'th, so that time slices keep their
+// length. Idle CPUs take no periodic interrupts, so no
+// samples.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+struct profring {
+  struct spinlock lock;
+  struct profsample s[NPROFSAMPLE];
+  uint w;               // samples written
+  uint r;               // samples read
+  uint dropped;         // samples lost because the ring was full
+};
+
+static struct profring ring[NCPU];
+static struct spinlock proflock;   // serializes start and stop
+
+int profiling;          // take samples?
+int profmult = 1;       // periodic timer interrupts per time slice
+
+void
+profinit(void)
+{
+  initlock(&proflock, "prof");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&ring[i].lock, "profring");
+}
+
+// Record where this CPU was when the timer interrupted it.
+// Called by devintr(), with interrupts off.
+void
+profsample(void)
+{
+  struct profring *r = &ring[cpuid()];
+  struct proc *p = myproc();
+  struct profsample *s;
+
+  acquire(&r->lock);
+  if(r->w - r->r == NPROFSAMPLE){
+    r->dropped++;
+  } else {
+    s = &r->s[r->w++ % NPROFSAMPLE];
+    s->pc = r_sepc();
+    s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+    s->pid = p ? p->pid : 0;
+    if(p)
+      safestrcpy(s->name, p->name, sizeof(s->name));
+    else
+      s->name[0] = 0;
+  }
+  release(&r->lock);
+}
+
+// prof() system call: start or stop sampling, or copy up to
+// n samples to user address addr and return how many.
+int
+prof(int op, uint64 addr, int n)
+{
+  struct profring *r;
+  struct profsample s;
+  int i, got, dropped;
+
+  switch(op){
+  case PROF_START:
+    acquire(&proflock);
+    for(i = 0; i < NCPU; i++){
+      acquire(&ring[i].lock);
+      ring[i].w = ring[i].r = ring[i].dropped = 0;
+      release(&ring[i].lock);
+    }
+    profmult = PROFMULT;
+    profiling = 1;
+    release(&proflock);
+    return 0;
+
+  case PROF_STOP:
+    acquire(&proflock);
+    profiling = 0;
+    profmult = 1;
+    dropped = 0;
+    for(i = 0; i < NCPU; i++)
+      dropped += ring[i].dropped;
+    release(&proflock);
+    return dropped;
+
+  case PROF_READ:
+    got = 0;
+    for(r = ring; r < &ring[NCPU] && got < n; r++){
+      for(;;){
+        acquire(&r->lock);
+        if(r->r == r->w){
+          release(&r->lock);
+          break;
+        }
+        s = r->s[r->r++ % NPROFSAMPLE];
+        release(&r->lock);
+        if(copyout(myproc()->pagetable, addr + got*sizeof(s), (char*)&s, sizeof(s)) < 0)
+          return -1;
+        if(++got == n)
+          break;
+      }
+    }
+    return got;
+  }
+  return -1;
+}
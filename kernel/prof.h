@@ -0,0 +1,17 @@
+// Sampling profiler: samples taken on timer interrupts,
+// and read with prof().
+
+#define NPROFSAMPLE 2048  // samples each CPU holds until read
+#define PROFMULT    10    // timer interrupts per time slice while profiling
+
+// prof() operations.
+#define PROF_START  0     // discard old samples and start sampling
+#define PROF_STOP   1     // stop; returns the number of samples dropped
+#define PROF_READ   2     // copy out and remove samples
+
+struct profsample {
+  uint64 pc;              // interrupted program counter
+  int pid;                // process running, or 0 if none
+  int user;               // 1 if pc is a user address
+  char name[16];          // the process's name
+};
@@ -256,6 +256,21 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor Counter-Enable
+static inline void
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -345,6 +360,7 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PTE_X (1L << 3) // executable
 #define PTE_U (1L << 4) // user-accessible
 #define PTE_S (1L << 8) // shared page
+#define PTE_COW (1L << 9) // copy-on-write: read-only until written
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
@@ -0,0 +1,29 @@
+// A process's memory, as reported by shminfo(): its heap,
+// its shared mappings, and what they cost.
+
+// One shared mapping.
+struct shmseg {
+  uint64 start;     // first address
+  uint64 end;       // one past the last address
+  int prot;         // PROT_ bits of its first page now
+  int maxprot;      // PROT_ bits it was mapped with
+  int flags;        // MAP_ flags if mmap()ed from a file, else 0
+  int npages;       // pages mapped
+  int maxref;       // most references to any one of its frames
+  uint64 refs;      // references to its frames, summed
+};
+
+struct shminfo {
+  int pid;
+  int nthread;      // threads besides the process itself
+  char name[16];
+  uint64 sz;        // size of the heap, text and stack
+  int heappages;    // pages mapped below sz
+  int cowpages;     // of those, copy-on-write
+  int shmpages;     // pages in shared mappings
+  int ptpages;      // page-table pages
+  int peakpages;    // most heap and shared pages since exec
+  int freepages;    // free physical pages, system-wide
+  int nseg;
+  struct shmseg seg[NVMA];
+};
@@ -16,15 +16,29 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+#ifdef LOCKSTAT
+  lk->class = lockstat_class(name, 1);
+#endif
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+#ifdef LOCKSTAT
+  uint64 nsleep = 0;
+  uint64 t0 = r_time();
   while (lk->locked) {
     sleep(lk, &lk->lk);
+    nsleep++;
   }
+  lockstat_acquired(lk->class, nsleep, r_time() - t0);
+  lk->tacquire = r_time();
+#else
+  while (lk->locked) {
+    sleep(lk, &lk->lk);
+  }
+#endif
   lk->locked = 1;
   lk->pid = myproc()->pid;
   release(&lk->lk);
@@ -34,6 +48,9 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+#ifdef LOCKSTAT
+  lockstat_released(lk->class, lk->tacquire);
+#endif
   lk->locked = 0;
   lk->pid = 0;
   wakeup(lk);
@@ -6,5 +6,9 @@ struct sleeplock {
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+#ifdef LOCKSTAT
+  int class;         // index into the lockstat table, or -1
+  uint64 tacquire;   // r_time() when acquired
+#endif
 };
 
@@ -7,6 +7,7 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -14,6 +15,54 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+#ifdef TICKETLOCK
+  lk->ticket = 0;
+  lk->next = 0;
+  lk->owner = 0;
+#endif
+#ifdef LOCKSTAT
+  lk->class = lockstat_class(name, 0);
+#endif
+}
+
+// Initialize a heavily contended lock. When the kernel is
+// built with TICKETLOCK=1 it is a FIFO ticket lock, which
+// is fair and has waiters spin reading a single word
+// instead of each hammering the line with atomic swaps;
+// otherwise it is an ordinary spinlock.
+void
+initqlock(struct spinlock *lk, char *name)
+{
+  initlock(lk, name);
+#ifdef TICKETLOCK
+  lk->ticket = 1;
+#endif
+}
+
+// Spin until this CPU owns lk.
+// Returns the number of times around the loop.
+static inline uint64
+spinwait(struct spinlock *lk)
+{
+  uint64 n = 0;
+
+#ifdef TICKETLOCK
+  if(lk->ticket){
+    uint t = __sync_fetch_and_add(&lk->next, 1);
+    while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != t)
+      n++;
+    lk->locked = 1;
+    return n;
+  }
+#endif
+
+  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  //   a5 = 1
+  //   s1 = &lk->locked
+  //   amoswap.w.aq a5, a5, (s1)
+  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    n++;
+  return n;
 }
 
 // Acquire the lock.
@@ -25,12 +74,13 @@ acquire(struct spinlock *lk)
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+#ifdef LOCKSTAT
+  uint64 t0 = r_time();
+  uint64 nspin = spinwait(lk);
+  uint64 twait = r_time() - t0;
+#else
+  spinwait(lk);
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +90,10 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+#ifdef LOCKSTAT
+  lockstat_acquired(lk->class, nspin, twait);
+  lk->tacquire = r_time();
+#endif
 }
 
 // Release the lock.
@@ -49,6 +103,9 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+#ifdef LOCKSTAT
+  lockstat_released(lk->class, lk->tacquire);
+#endif
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,6 +116,16 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#ifdef TICKETLOCK
+  if(lk->ticket){
+    // Serve the next ticket. Only the holder writes owner.
+    lk->locked = 0;
+    __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+    pop_off();
+    return;
+  }
+#endif
+
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -108,3 +175,109 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+#ifdef LOCKSTAT
+
+// One entry per lock name. Entries are claimed with a
+// compare-and-swap on name, so initlock() needs no lock,
+// and are never freed; the counters are updated with
+// atomic adds since locks of one name are acquired on
+// many CPUs at once.
+static struct {
+  char *name;
+  struct lockstat st;
+} lockclass[NLOCKCLASS];
+
+// Return the lockstat table index for locks called name,
+// adding an entry if this is the first such lock.
+// Returns -1 if the table is full.
+int
+lockstat_class(char *name, int sleep)
+{
+  int i;
+  char *n;
+
+  for(i = 0; i < NLOCKCLASS; i++){
+    n = lockclass[i].name;
+    if(n == 0 && __sync_bool_compare_and_swap(&lockclass[i].name, 0, name)){
+      safestrcpy(lockclass[i].st.name, name, sizeof(lockclass[i].st.name));
+      lockclass[i].st.sleep = sleep;
+      return i;
+    }
+    n = lockclass[i].name;
+    if(n == name || strncmp(n, name, sizeof(lockclass[i].st.name)) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void
+lockstat_acquired(int class, uint64 nspin, uint64 twait)
+{
+  struct lockstat *st;
+  uint64 max;
+
+  if(class < 0)
+    return;
+  st = &lockclass[class].st;
+  __sync_fetch_and_add(&st->nacquire, 1);
+  if(nspin){
+    __sync_fetch_and_add(&st->ncontended, 1);
+    __sync_fetch_and_add(&st->nspin, nspin);
+    __sync_fetch_and_add(&st->waittime, twait);
+    while((max = st->maxwait) < twait)
+      if(__sync_bool_compare_and_swap(&st->maxwait, max, twait))
+        break;
+  }
+}
+
+void
+lockstat_released(int class, uint64 tacquire)
+{
+  uint64 t;
+  int b;
+
+  if(class < 0)
+    return;
+  t = r_time() - tacquire;
+  for(b = 0; t > 1 && b < NLSHIST-1; b++)
+    t >>= 1;
+  __sync_fetch_and_add(&lockclass[class].st.hold[b], 1);
+}
+
+// lockstat() system call: copy up to n entries to the
+// user array at addr, or reset the counters.
+// Returns the number of entries copied.
+int
+lockstat(int op, uint64 addr, int n)
+{
+  struct lockstat st;
+  int i;
+
+  if(op == LS_RESET){
+    for(i = 0; i < NLOCKCLASS; i++){
+      struct lockstat *s = &lockclass[i].st;
+      memset(&s->nacquire, 0, sizeof(*s) - ((char*)&s->nacquire - (char*)s));
+    }
+    return 0;
+  }
+  if(op != LS_READ)
+    return -1;
+
+  for(i = 0; i < NLOCKCLASS && i < n && lockclass[i].name; i++){
+    st = lockclass[i].st;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
+
+#else
+
+int
+lockstat(int op, uint64 addr, int n)
+{
+  return -1;
+}
+
+#endif
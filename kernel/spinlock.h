@@ -5,5 +5,14 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+#ifdef TICKETLOCK
+  int ticket;        // FIFO ticket lock? (see initqlock())
+  uint next;         // next ticket to hand out
+  uint owner;        // ticket now being served
+#endif
+#ifdef LOCKSTAT
+  int class;         // index into the lockstat table, or -1
+  uint64 tacquire;   // r_time() when acquired
+#endif
 };
 
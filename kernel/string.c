@@ -4,10 +4,24 @@ void*
 memset(void *dst, int c, uint n)
 {
   char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uint64 w;
+
+  // fill the aligned middle 8 bytes at a time, 32 per loop.
+  if(n >= 16){
+    for(; (uint64)cdst & 7; n--)
+      *cdst++ = c;
+    w = (uchar)c * 0x0101010101010101UL;
+    for(; n >= 32; n -= 32, cdst += 32){
+      ((uint64*)cdst)[0] = w;
+      ((uint64*)cdst)[1] = w;
+      ((uint64*)cdst)[2] = w;
+      ((uint64*)cdst)[3] = w;
+    }
+    for(; n >= 8; n -= 8, cdst += 8)
+      *(uint64*)cdst = w;
   }
+  while(n-- > 0)
+    *cdst++ = c;
   return dst;
 }
 
@@ -18,6 +32,15 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  // skip equal aligned words; the byte loop below then
+  // finds the first difference.
+  if(n >= 16 && (((uint64)s1 ^ (uint64)s2) & 7) == 0){
+    for(; (uint64)s1 & 7; n--, s1++, s2++)
+      if(*s1 != *s2)
+        return *s1 - *s2;
+    for(; n >= 8 && *(uint64*)s1 == *(uint64*)s2; n -= 8)
+      s1 += 8, s2 += 8;
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -38,14 +61,41 @@ memmove(void *dst, const void *src, uint n)
   
   s = src;
   d = dst;
+  // when source and destination are equally aligned, the
+  // bulk moves as aligned 8-byte words.
   if(s < d && s + n > d){
     s += n;
     d += n;
+    if((((uint64)s ^ (uint64)d) & 7) == 0 && n >= 16){
+      while((uint64)d & 7){
+        *--d = *--s;
+        n--;
+      }
+      for(; n >= 8; n -= 8){
+        d -= 8, s -= 8;
+        *(uint64*)d = *(const uint64*)s;
+      }
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if((((uint64)s ^ (uint64)d) & 7) == 0 && n >= 16){
+      while((uint64)d & 7){
+        *d++ = *s++;
+        n--;
+      }
+      for(; n >= 32; n -= 32, d += 32, s += 32){
+        ((uint64*)d)[0] = ((const uint64*)s)[0];
+        ((uint64*)d)[1] = ((const uint64*)s)[1];
+        ((uint64*)d)[2] = ((const uint64*)s)[2];
+        ((uint64*)d)[3] = ((const uint64*)s)[3];
+      }
+      for(; n >= 8; n -= 8, d += 8, s += 8)
+        *(uint64*)d = *(const uint64*)s;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
@@ -6,13 +6,16 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "trace.h"
+#include "sysstat.h"
 
 // Fetch the uint64 at addr from the current process.
 int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz) // both tests needed, in case of overflow
+  uint64 sz = procleader(p)->sz;
+  if(addr >= sz || addr+sizeof(uint64) > sz) // both tests needed, in case of overflow
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -103,6 +106,20 @@ extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_map_shared_pages(void);
 extern uint64 sys_unmap_shared_pages(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_vmsplice(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_mprotect(void);
+extern uint64 sys_shminfo(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_nanosleep(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -130,19 +147,54 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_map_shared_pages]   sys_map_shared_pages,
 [SYS_unmap_shared_pages] sys_unmap_shared_pages,
+[SYS_lockstat] sys_lockstat,
+[SYS_vmsplice] sys_vmsplice,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_clone] sys_clone,
+[SYS_join] sys_join,
+[SYS_mprotect] sys_mprotect,
+[SYS_shminfo] sys_shminfo,
+[SYS_mmap] sys_mmap,
+[SYS_prof] sys_prof,
+[SYS_trace] sys_trace,
+[SYS_sysstat] sys_sysstat,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_nanosleep] sys_nanosleep,
 };
 
+// Count a call that took t time ticks.
+static void
+countcall(struct sysstat *s, uint64 t)
+{
+  uint64 b;
+  int i;
+
+  s->count++;
+  s->time += t;
+  for(i = 0, b = 8; i < NSSHIST-1 && t >= b; i++, b *= 8)
+    ;
+  s->hist[i]++;
+}
+
 void
 syscall(void)
 {
   int num;
+  uint64 t0;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
+  memset(p->ucache, 0, sizeof(p->ucache));
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
+    TRACE(TR_SYSENTER, num, 0);
+    t0 = r_time();
     p->trapframe->a0 = syscalls[num]();
+    if(num < NSYSCALL)
+      countcall(&p->sysstat->self[num], r_time() - t0);
+    TRACE(TR_SYSEXIT, num, p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
@@ -22,3 +22,17 @@
 #define SYS_close  21
 #define SYS_map_shared_pages    22
 #define SYS_unmap_shared_pages  23
+#define SYS_lockstat 24
+#define SYS_vmsplice 25
+#define SYS_futex_wait 26
+#define SYS_futex_wake 27
+#define SYS_clone 28
+#define SYS_join 29
+#define SYS_mprotect 30
+#define SYS_shminfo 31
+#define SYS_mmap 32
+#define SYS_prof 33
+#define SYS_trace 34
+#define SYS_sysstat 35
+#define SYS_clock_gettime 36
+#define SYS_nanosleep 37
@@ -25,7 +25,7 @@ argfd(int n, int *pfd, struct file **pf)
   struct file *f;
 
   argint(n, &fd);
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE || (f=procleader(myproc())->ofile[fd]) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -36,18 +36,22 @@ argfd(int n, int *pfd, struct file **pf)
 
 // Allocate a file descriptor for the given file.
 // Takes over file reference from caller on success.
+// Threads share their process's table, so hold its lock.
 static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *p = procleader(myproc());
 
+  acquire(&p->lock);
   for(fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd] == 0){
       p->ofile[fd] = f;
+      release(&p->lock);
       return fd;
     }
   }
+  release(&p->lock);
   return -1;
 }
 
@@ -94,15 +98,39 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+uint64
+sys_vmsplice(void)
+{
+  struct file *f;
+  int n;
+  uint64 p;
+
+  argaddr(1, &p);
+  argint(2, &n);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+
+  return filevmsplice(f, p, n);
+}
+
 uint64
 sys_close(void)
 {
   int fd;
   struct file *f;
+  struct proc *p = procleader(myproc());
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
+  // another thread may be closing fd too; only one of us
+  // takes it out of the table and drops its reference.
+  acquire(&p->lock);
+  if(p->ofile[fd] != f){
+    release(&p->lock);
+    return -1;
+  }
+  p->ofile[fd] = 0;
+  release(&p->lock);
   fileclose(f);
   return 0;
 }
@@ -411,7 +439,7 @@ sys_chdir(void)
 {
   char path[MAXPATH];
   struct inode *ip;
-  struct proc *p = myproc();
+  struct proc *p = procleader(myproc());
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
@@ -481,6 +509,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
   struct proc *p = myproc();
+  struct file **ofile = procleader(p)->ofile;
 
   argaddr(0, &fdarray);
   if(pipealloc(&rf, &wf) < 0)
@@ -488,18 +517,74 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
+      ofile[fd0] = 0;
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+    ofile[fd0] = 0;
+    ofile[fd1] = 0;
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   return 0;
 }
+
+// mmap(fd, off, len, prot, flags): map len bytes of an open
+// file from off, which must be page-aligned and within the
+// file, into the shared region. Returns the address, or 0.
+uint64
+sys_mmap(void)
+{
+  struct file *f;
+  int off, len, prot, flags, maxprot, i, n;
+  uint64 *pa, va;
+  struct proc *p = procleader(myproc());
+
+  argint(1, &off);
+  argint(2, &len);
+  argint(3, &prot);
+  argint(4, &flags);
+  if(argfd(0, 0, &f) < 0)
+    return 0;
+  if(f->type != FD_INODE || !f->readable || off < 0 || off % PGSIZE != 0 || len <= 0)
+    return 0;
+  if((flags != MAP_SHARED && flags != MAP_PRIVATE) || (prot & ~(PROT_READ|PROT_WRITE)) != 0)
+    return 0;
+  // stores to a shared mapping reach the file, so need it open
+  // for writing; stores to a private one never do.
+  maxprot = PROT_READ;
+  if(flags == MAP_PRIVATE || f->writable)
+    maxprot |= PROT_WRITE;
+  if((prot & ~maxprot) != 0)
+    return 0;
+
+  // a page of frame addresses; a file has fewer pages than that.
+  if((pa = (uint64*)kalloc()) == 0)
+    return 0;
+  n = PGROUNDUP(len) / PGSIZE;
+  i = 0;
+  ilock(f->ip);
+  if(f->ip->type != T_FILE || (uint64)off + len > PGROUNDUP(f->ip->size))
+    goto bad;
+  for(; i < n; i++)
+    if((pa[i] = pcget(f->ip, off / PGSIZE + i)) == 0)
+      goto bad;
+  iunlock(f->ip);
+
+  acquire(&p->lock);
+  va = vmammap(p, pa, n, f, off, prot, maxprot, flags);
+  release(&p->lock);
+  kfree(pa);
+  return va;
+
+ bad:
+  iunlock(f->ip);
+  while(--i >= 0)
+    kfree((void*)pa[i]);
+  kfree(pa);
+  return 0;
+}
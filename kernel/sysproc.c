@@ -43,8 +43,7 @@ sys_sbrk(void)
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if(growproc(n, &addr) < 0)
     return -1;
   return addr;
 }
@@ -53,20 +52,11 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  return sleepfor((uint64)n * TICKINTERVAL);
 }
 
 uint64
@@ -83,12 +73,24 @@ sys_kill(void)
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return r_time() / TICKINTERVAL;
+}
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+// nanoseconds since boot.
+uint64
+sys_clock_gettime(void)
+{
+  return r_time() * NSPERTIME;
+}
+
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  argaddr(0, &ns);
+  // round up, without overflowing for huge ns.
+  return sleepfor(ns / NSPERTIME + (ns % NSPERTIME != 0));
 }
 
 uint64
@@ -97,14 +99,16 @@ sys_map_shared_pages(void)
   int source_pid_from_arg;
   uint64 src_va_from_arg;
   int size_from_arg;
+  int prot_from_arg;
   struct proc *p_iterator;
   struct proc *identified_source_process = 0;
-  struct proc *destination_process = myproc(); // התהליך שקורא לקריאת המערכת הוא היעד
+  struct proc *destination_process = procleader(myproc()); // התהליך שקורא לקריאת המערכת הוא היעד
 
   // קבלת ארגומנטים ממרחב המשתמש
   argint(0, &source_pid_from_arg);
   argaddr(1, &src_va_from_arg);
   argint(2, &size_from_arg);
+  argint(3, &prot_from_arg);
 
   // ולידציה בסיסית של ערכי הארגומנטים
   if(source_pid_from_arg <= 0 || src_va_from_arg == 0 || size_from_arg <= 0) {
@@ -127,6 +131,13 @@ sys_map_shared_pages(void)
   if(identified_source_process == 0) {
     return 0; // תהליך המקור לא נמצא או לא במצב תקין
   }
+  // a thread's memory is its process's.
+  if(identified_source_process->leader) {
+    struct proc *leader = identified_source_process->leader;
+    release(&identified_source_process->lock);
+    identified_source_process = leader;
+    acquire(&identified_source_process->lock);
+  }
   // נעילה בטוחה של שני התהליכים למניעת deadlock
   int need_dest_lock = (identified_source_process != destination_process);
   
@@ -144,7 +155,7 @@ sys_map_shared_pages(void)
   }
 
   // כעת שני התהליכים נעולים בבטחה - בצע את המיפוי
-  uint64 result = map_shared_pages(identified_source_process, destination_process, src_va_from_arg, (uint64)size_from_arg);
+  uint64 result = map_shared_pages(identified_source_process, destination_process, src_va_from_arg, (uint64)size_from_arg, prot_from_arg);
 
   // שחרר נעילות בסדר הפוך
   if(need_dest_lock) {
@@ -175,16 +186,148 @@ sys_unmap_shared_pages(void)
   if(addr == 0 || size <= 0)
     return -1;
   
-  struct proc *p = myproc();
+  struct proc *p = procleader(myproc());
+  struct file *f;
+
+  // stores to a shared file mapping go back to the file first.
+  vmaflush(p, addr, addr + size);
   
   // נעילת התהליך לפני גישה לשדות שלו (דרישה חובה מההבהרה)
   acquire(&p->lock);
   
   // Add external declaration for unmap_shared_pages
-  extern uint64 unmap_shared_pages(struct proc*, uint64, uint64);
-  uint64 result = unmap_shared_pages(p, addr, size);
+  extern uint64 unmap_shared_pages(struct proc*, uint64, uint64, struct file**);
+  uint64 result = unmap_shared_pages(p, addr, size, &f);
   
   release(&p->lock);
+  if(result == 0 && f)
+    fileclose(f);
   
   return result;
 }
+
+// read or reset the lock contention statistics.
+// returns -1 if the kernel was built without LOCKSTAT.
+uint64
+sys_lockstat(void)
+{
+  int op, n;
+  uint64 addr;
+
+  argint(0, &op);
+  argaddr(1, &addr);
+  argint(2, &n);
+  return lockstat(op, addr, n);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int expected;
+
+  argaddr(0, &addr);
+  argint(1, &expected);
+  return futexwait(addr, expected);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return futexwake(addr, n);
+}
+
+uint64
+sys_mprotect(void)
+{
+  uint64 addr;
+  int len, prot, r;
+  struct proc *p = procleader(myproc());
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &prot);
+  if(len <= 0)
+    return -1;
+  acquire(&p->lock);
+  r = vmaprotect(p, addr, len, prot);
+  release(&p->lock);
+  return r;
+}
+
+// start or stop the sampling profiler, or read its samples.
+uint64
+sys_prof(void)
+{
+  int op, n;
+  uint64 addr;
+
+  argint(0, &op);
+  argaddr(1, &addr);
+  argint(2, &n);
+  return prof(op, addr, n);
+}
+
+// start or stop event tracing, or read the events.
+uint64
+sys_trace(void)
+{
+  int op, n;
+  uint64 addr;
+
+  argint(0, &op);
+  argaddr(1, &addr);
+  argint(2, &n);
+  return trace(op, addr, n);
+}
+
+// copy out a process's system call counts.
+uint64
+sys_sysstat(void)
+{
+  int pid, who;
+  uint64 addr;
+
+  argint(0, &pid);
+  argint(1, &who);
+  argaddr(2, &addr);
+  return sysstat(pid, who, addr);
+}
+
+// describe the memory of the first process with pid >= the
+// argument; returns its pid, or -1.
+uint64
+sys_shminfo(void)
+{
+  int pid;
+  uint64 addr;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  return shminfo(pid, addr);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+
+  argint(0, &tid);
+  return join(tid);
+}
@@ -0,0 +1,22 @@
+// System call statistics, counted by syscall() for each
+// process and read with sysstat().
+
+#define NSYSCALL   40   // system call numbers counted, from 0
+#define NSSHIST    8    // buckets in the latency histogram
+
+// sysstat() selects which counts.
+#define SS_SELF     0   // the process's own calls
+#define SS_CHILDREN 1   // those of the children it has reaped
+
+struct sysstat {
+  uint count;             // calls
+  uint hist[NSSHIST];     // hist[i] counts calls of 8^i..8^(i+1)-1 time
+                          // ticks; the last bucket, all longer ones
+  uint64 time;            // total time ticks in the call
+};
+
+// a process's counts, in a page of their own.
+struct sysstats {
+  struct sysstat self[NSYSCALL];
+  struct sysstat children[NSYSCALL];  // with their children's
+};
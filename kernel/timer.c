@@ -0,0 +1,190 @@
+// Timer interrupts and one-shot timers.
+//
+// There is no global clock tick. Time is the time CSR, which
+// every CPU can read, and each CPU asks for a timer interrupt
+// only when it wants one: periodically while it runs a
+// process, to preempt it (and to take profiling samples),
+// and at the first timer in the queue of sleeping processes.
+// An idle CPU asks only for the latter, so with no sleepers
+// it takes no timer interrupts at all.
+//
+// Timer interrupts arrive in machine mode at timervec, which
+// pushes mtimecmp an interval on as a fallback and passes
+// them to devintr() as software interrupts. devintr() calls
+// timerintr(), which sets this CPU's mtimecmp itself (the
+// kernel page table maps the CLINT) for the next interrupt
+// it wants.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NOTIME (~0ULL)  // a time never reached
+
+// a process waiting for a time, on its kernel stack.
+struct timer {
+  uint64 when;          // r_time() at which to wake
+  int fired;
+  struct timer *next;
+};
+
+static struct spinlock timerlock;
+static struct timer *timers;      // sorted by when
+static uint64 timernext = NOTIME; // when of the first timer; read without the lock
+
+void
+timerqinit(void)
+{
+  initlock(&timerlock, "timer");
+}
+
+// Program this CPU's next timer interrupt for the earlier of
+// its periodic interrupt and the first timer.
+// Called with interrupts off.
+static void
+program(void)
+{
+  uint64 when = mycpu()->nextintr;
+  uint64 next = __atomic_load_n(&timernext, __ATOMIC_ACQUIRE);
+
+  if(next < when)
+    when = next;
+  *(uint64*)CLINT_MTIMECMP(cpuid()) = when;
+}
+
+// Handle a timer interrupt: take a profiling sample and note
+// the end of a time slice if the periodic interrupt is due,
+// and fire due timers. Returns 1 at the end of a time slice.
+int
+timerintr(void)
+{
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+  uint64 period = TICKINTERVAL / profmult;
+  struct timer *t;
+  int tick = 0;
+
+  if(now >= c->nextintr){
+    if(profiling)
+      profsample();
+    // while profiling, the periodic interrupt comes profmult
+    // times as often, but time slices keep their length.
+    if(++c->subtick >= profmult){
+      c->subtick = 0;
+      tick = 1;
+    }
+    c->nextintr += period;
+    if(c->nextintr <= now)
+      c->nextintr = now + period;
+  }
+
+  if(__atomic_load_n(&timernext, __ATOMIC_ACQUIRE) <= now){
+    acquire(&timerlock);
+    while((t = timers) != 0 && t->when <= now){
+      timers = t->next;
+      t->fired = 1;
+      wakeup(t);
+    }
+    __atomic_store_n(&timernext, timers ? timers->when : NOTIME, __ATOMIC_RELEASE);
+    release(&timerlock);
+  }
+
+  program();
+  return tick;
+}
+
+// This CPU is about to run a process: start its periodic
+// interrupt, if it was idle. Called with interrupts off.
+void
+timerbusy(void)
+{
+  struct cpu *c = mycpu();
+
+  if(c->nextintr == NOTIME){
+    c->nextintr = r_time() + TICKINTERVAL / profmult;
+    c->subtick = 0;
+    program();
+  }
+}
+
+// This CPU has nothing to run: stop its periodic interrupt,
+// leaving only the timers. From now on timerwake() kicks it,
+// so the caller must look for runnable processes once more
+// before it waits. Called with interrupts off.
+void
+timeridle(void)
+{
+  __atomic_store_n(&mycpu()->nextintr, NOTIME, __ATOMIC_RELAXED);
+  program();
+  __sync_synchronize();
+}
+
+// Make cpu take a timer interrupt now, as if one were due,
+// so that it traps if it is running user code. Its
+// timerintr() then programs the interrupt it really wants.
+void
+timerkick(int cpu)
+{
+  *(uint64*)CLINT_MTIMECMP(cpu) = r_time();
+}
+
+// n processes have become runnable: make up to n idle CPUs,
+// which take no periodic interrupts, take one now so that
+// their schedulers look for them.
+void
+timerwake(int n)
+{
+  struct cpu *c;
+
+  __sync_synchronize();
+  for(c = cpus; c < &cpus[NCPU] && n > 0; c++){
+    if(__atomic_load_n(&c->nextintr, __ATOMIC_RELAXED) == NOTIME){
+      timerkick(c - cpus);
+      n--;
+    }
+  }
+}
+
+// Sleep for n units of r_time(). A sleep too long to end
+// before the clock wraps lasts until killed. Returns 0, or
+// -1 if killed.
+int
+sleepfor(uint64 n)
+{
+  struct timer t, **tp;
+  struct proc *p = myproc();
+  uint64 now = r_time();
+  uint64 when = n < NOTIME - now ? now + n : NOTIME;
+
+  t.when = when;
+  t.fired = 0;
+  acquire(&timerlock);
+  for(tp = &timers; *tp && (*tp)->when <= t.when; tp = &(*tp)->next)
+    ;
+  t.next = *tp;
+  *tp = &t;
+  if(timers == &t){
+    // other CPUs see the new time at their next interrupt;
+    // this one makes sure there is one.
+    __atomic_store_n(&timernext, when, __ATOMIC_RELEASE);
+    program();
+  }
+
+  while(!t.fired){
+    if(killed(p)){
+      for(tp = &timers; *tp != &t; tp = &(*tp)->next)
+        ;
+      *tp = t.next;
+      __atomic_store_n(&timernext, timers ? timers->when : NOTIME, __ATOMIC_RELEASE);
+      release(&timerlock);
+      return -1;
+    }
+    sleep(&t, &timerlock);
+  }
+  release(&timerlock);
+  return 0;
+}
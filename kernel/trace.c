@@ -0,0 +1,124 @@
+// Event tracing.
+//
+// Each CPU has a ring of events. Only that CPU adds to it,
+// with interrupts off, and only trace(TRACE_READ) removes
+// from it, so a ring needs no lock: the writer advances w
+// after filling an event, the reader advances r after
+// copying one, and each only reads the other's index.
+// When a ring is full new events are dropped and counted.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+struct tracering {
+  struct traceevent e[NTRACE];
+  uint w;               // events written
+  uint r;               // events read
+  uint dropped;         // events lost because the ring was full
+};
+
+static struct tracering ring[NCPU];
+static struct sleeplock readlock;  // one reader, or start, at a time
+static uint dropbase;              // dropped events when started
+
+int tracemask;          // event types being recorded
+
+void
+traceinit(void)
+{
+  initsleeplock(&readlock, "trace");
+}
+
+// Record an event of the given type on this CPU's ring.
+// Called by the TRACE() tracepoints.
+void
+tracerecord(int type, uint64 a0, uint64 a1)
+{
+  struct tracering *r;
+  struct traceevent *e;
+  struct proc *p;
+  uint w;
+
+  push_off();
+  r = &ring[cpuid()];
+  w = r->w;
+  if(w - __atomic_load_n(&r->r, __ATOMIC_ACQUIRE) >= NTRACE){
+    r->dropped++;
+  } else {
+    p = myproc();
+    e = &r->e[w % NTRACE];
+    e->time = r_time();
+    e->type = type;
+    e->cpu = cpuid();
+    e->pid = p ? p->pid : 0;
+    e->arg[0] = a0;
+    e->arg[1] = a1;
+    __atomic_store_n(&r->w, w + 1, __ATOMIC_RELEASE);
+  }
+  pop_off();
+}
+
+// sum of the rings' dropped counts.
+static uint
+dropped(void)
+{
+  uint n = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    n += __atomic_load_n(&ring[i].dropped, __ATOMIC_RELAXED);
+  return n;
+}
+
+// trace() system call: start recording the event types in
+// mask n, or stop, or copy up to n events to user address
+// addr and return how many.
+int
+trace(int op, uint64 addr, int n)
+{
+  struct tracering *r;
+  struct traceevent e;
+  uint ri;
+  int i, got;
+
+  switch(op){
+  case TRACE_START:
+    acquiresleep(&readlock);
+    tracemask = 0;
+    for(i = 0; i < NCPU; i++)
+      __atomic_store_n(&ring[i].r, __atomic_load_n(&ring[i].w, __ATOMIC_ACQUIRE),
+                       __ATOMIC_RELEASE);
+    dropbase = dropped();
+    tracemask = n & ((1 << NTREVENT) - 1);
+    releasesleep(&readlock);
+    return 0;
+
+  case TRACE_STOP:
+    tracemask = 0;
+    return dropped() - dropbase;
+
+  case TRACE_READ:
+    got = 0;
+    acquiresleep(&readlock);
+    for(r = ring; r < &ring[NCPU] && got < n; r++){
+      for(ri = r->r; got < n && ri != __atomic_load_n(&r->w, __ATOMIC_ACQUIRE); ri++){
+        e = r->e[ri % NTRACE];
+        __atomic_store_n(&r->r, ri + 1, __ATOMIC_RELEASE);
+        if(copyout(myproc()->pagetable, addr + got*sizeof(e), (char*)&e, sizeof(e)) < 0){
+          releasesleep(&readlock);
+          return -1;
+        }
+        got++;
+      }
+    }
+    releasesleep(&readlock);
+    return got;
+  }
+  return -1;
+}
@@ -0,0 +1,34 @@
+// Event tracing: tracepoints in the kernel record timestamped
+// events in per-CPU rings, and trace() reads them.
+
+#define NTRACE 2048       // events each CPU holds until read
+
+// event types, and what arg[0] and arg[1] hold.
+#define TR_SYSENTER    1  // system call number
+#define TR_SYSEXIT     2  // system call number, return value
+#define TR_SWITCHIN    3  // scheduler runs pid
+#define TR_SWITCHOUT   4  // pid gives up the CPU, its new state
+#define TR_KALLOC      5  // page allocated
+#define TR_KFREE       6  // page freed
+#define TR_DISKSTART   7  // block number, 1 if a write
+#define TR_DISKDONE    8  // block number
+#define TR_COMMITSTART 9  // blocks in the transaction
+#define TR_COMMITDONE  10
+#define NTREVENT       11
+
+// trace() operations.
+#define TRACE_START    0  // discard old events, record types in mask n
+#define TRACE_STOP     1  // stop; returns the number of events dropped
+#define TRACE_READ     2  // copy out and remove events
+
+struct traceevent {
+  uint64 time;            // r_time(): time-CSR ticks (100ns in qemu)
+  ushort type;
+  ushort cpu;
+  int pid;                // process running, or 0 if none
+  uint64 arg[2];
+};
+
+// a tracepoint; costs a load and a test while tracing is off.
+#define TRACE(type, a0, a1) \
+  do { if(tracemask & (1 << (type))) tracerecord(type, a0, a1); } while(0)
@@ -6,9 +6,6 @@
 #include "proc.h"
 #include "defs.h"
 
-struct spinlock tickslock;
-uint ticks;
-
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -16,12 +13,6 @@ void kernelvec();
 
 extern int devintr();
 
-void
-trapinit(void)
-{
-  initlock(&tickslock, "time");
-}
-
 // set up to take exceptions and traps while in the kernel.
 void
 trapinithart(void)
@@ -45,6 +36,12 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // uservec flushed the TLB of user translations; tell
+  // vmchanged().
+  struct cpu *c = mycpu();
+  __atomic_store_n(&c->upagetable, 0, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&c->utraps, 1, __ATOMIC_RELEASE);
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -67,6 +64,8 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(r_scause() == 15 && uvmcow(p->pagetable, r_stval()) == 0){
+    // store to a copy-on-write page; it now has its own copy.
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -122,11 +121,18 @@ usertrapret(void)
   // tell trampoline.S the user page table to switch to.
   uint64 satp = MAKE_SATP(p->pagetable);
 
+  // from now until the next trap, this CPU's TLB may hold
+  // translations from p->pagetable, which vmchanged() must
+  // wait out. the fence orders this against its reading of
+  // the page table.
+  __atomic_store_n(&mycpu()->upagetable, p->pagetable, __ATOMIC_RELEASE);
+  __sync_synchronize();
+
   // jump to userret in trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, p->tfva);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -160,15 +166,6 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
-clockintr()
-{
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
-}
-
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
@@ -205,15 +202,13 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before timerintr() looks at the
+    // time, so that a timer interrupt after that isn't lost.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    // 2 ends the time slice.
+    return timerintr() ? 2 : 1;
   } else {
     return 0;
   }
@@ -15,6 +15,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "trace.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -278,6 +279,7 @@ virtio_disk_rw(struct buf *b, int write)
 
   __sync_synchronize();
 
+  TRACE(TR_DISKSTART, b->blockno, write);
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
   // Wait for virtio_disk_intr() to say request has finished.
@@ -317,6 +319,7 @@ virtio_disk_intr()
       panic("virtio_disk_intr status");
 
     struct buf *b = disk.info[id].b;
+    TRACE(TR_DISKDONE, b->blockno, 0);
     b->disk = 0;   // disk is done with buf
     wakeup(b);
 
@@ -7,6 +7,8 @@
 #include "spinlock.h"
 #include "fs.h"
 #include "proc.h"
+#include "fcntl.h"
+#include "shminfo.h"
 
 /*
  * the kernel's page table.
@@ -32,6 +34,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, for timerintr() to set mtimecmp
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -51,11 +56,27 @@ kvmmake(void)
   return kpgtbl;
 }
 
+// Code that looks at a user PTE's copy-on-write state and then
+// changes it, such as a copy-on-write break, holds a lock
+// chosen by the page table, since threads share it. The lock
+// is taken after any other, even those copyout()'s callers hold.
+#define NCOWLOCK 16
+
+struct spinlock cowlock[NCOWLOCK];
+
+static struct spinlock*
+cowhash(pagetable_t pagetable)
+{
+  return &cowlock[((uint64)pagetable / PGSIZE) % NCOWLOCK];
+}
+
 // Initialize the one kernel_pagetable
 void
 kvminit(void)
 {
   kernel_pagetable = kvmmake();
+  for(int i = 0; i < NCOWLOCK; i++)
+    initlock(&cowlock[i], "cow");
 }
 
 // Switch h/w page table register to the kernel's page table,
@@ -84,8 +105,11 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
-pte_t *
-walk(pagetable_t pagetable, uint64 va, int alloc)
+//
+// walkcount() counts any page-table pages it allocates in
+// *vc, unless vc is 0.
+static pte_t *
+walkcount(pagetable_t pagetable, uint64 va, int alloc, struct vmcount *vc)
 {
   if(va >= MAXVA)
     panic("walk");
@@ -99,11 +123,51 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
         return 0;
       memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
+      if(vc)
+        vc->ptpages++;
     }
   }
   return &pagetable[PX(0, va)];
 }
 
+pte_t *
+walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  return walkcount(pagetable, va, alloc, 0);
+}
+
+// Bumped whenever a user mapping is removed or loses
+// permissions, which invalidates every cached translation.
+uint64 vmgen = 1;
+
+// A mapping in pagetable has been removed or has lost
+// permissions. Besides the translations cached for copyin()
+// and copyout(), other CPUs running threads that share
+// pagetable in user mode may still have the old one in their
+// TLBs. A CPU flushes its TLB whenever it traps from user
+// mode, so wait for each of them to trap, making them take a
+// timer interrupt at once. Only then may the caller free the
+// old frame or count on the lost permission.
+static void
+vmchanged(pagetable_t pagetable)
+{
+  struct cpu *c;
+  uint64 n;
+
+  __atomic_fetch_add(&vmgen, 1, __ATOMIC_RELEASE);
+  __sync_synchronize();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(__atomic_load_n(&c->upagetable, __ATOMIC_ACQUIRE) != pagetable)
+      continue;
+    n = __atomic_load_n(&c->utraps, __ATOMIC_ACQUIRE);
+    // the CPU may reprogram its timer before it sees the
+    // kick, so kick until it traps.
+    while(__atomic_load_n(&c->upagetable, __ATOMIC_ACQUIRE) == pagetable &&
+          __atomic_load_n(&c->utraps, __ATOMIC_ACQUIRE) == n)
+      timerkick(c - cpus);
+  }
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
@@ -133,19 +197,38 @@ walkaddr(pagetable_t pagetable, uint64 va)
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
+  if(mappages(kpgtbl, va, sz, pa, perm, 0) != 0)
     panic("kvmmap");
 }
 
+// Count n more user pages in *vc, as shared if perm has PTE_S,
+// else private, and note any new peak.
+static void
+vmmapped(struct vmcount *vc, int perm, int n)
+{
+  if(vc == 0)
+    return;
+  if(perm & PTE_S)
+    vc->shared += n;
+  else
+    vc->private += n;
+  if(vc->private + vc->shared > vc->peak)
+    vc->peak = vc->private + vc->shared;
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned. Returns 0 on success, -1 if walk() couldn't
-// allocate a needed page-table page.
+// allocate a needed page-table page. Counts the pages in *vc,
+// the counts of the process whose page table it is, or 0 for
+// the kernel's; its lock is held if other threads may use it.
 int
-mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
+mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm,
+         struct vmcount *vc)
 {
   uint64 a, last;
   pte_t *pte;
+  int n = 0;
 
   if(size == 0)
     panic("mappages: size");
@@ -153,27 +236,35 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = PGROUNDDOWN(va);
   last = PGROUNDDOWN(va + size - 1);
   for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0)
+    if((pte = walkcount(pagetable, a, 1, vc)) == 0){
+      vmmapped(vc, perm, n);
       return -1;
+    }
     if(*pte & PTE_V)
       panic("mappages: remap");
     *pte = PA2PTE(pa) | perm | PTE_V;
+    if(a < SHMTOP)
+      n++;
     if(a == last)
       break;
     a += PGSIZE;
     pa += PGSIZE;
   }
+  vmmapped(vc, perm, n);
   return 0;
 }
 
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
 // Optionally free the physical memory.
+// Takes the pages out of *vc, as for mappages().
 void
-uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
+uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free,
+         struct vmcount *vc)
 {
   uint64 a;
   pte_t *pte;
+  int private = 0, shared = 0;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
@@ -184,26 +275,41 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     
-    // Only free the physical page if do_free is set AND it's not a shared page
-    if(do_free && (*pte & PTE_S) == 0) {
-      uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
+    if(a < SHMTOP && (*pte & PTE_S))
+      shared++;
+    else if(a < SHMTOP)
+      private++;
+    // keep the frame's address until no TLB can hold it.
+    *pte = do_free ? *pte & ~PTE_V : 0;
+  }
+  if(vc){
+    vc->private -= private;
+    vc->shared -= shared;
+  }
+  vmchanged(pagetable);
+
+  // Shared pages are reference counted too, so each mapping
+  // that goes drops one reference
+  if(do_free){
+    for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+      pte = walk(pagetable, a, 0);
+      kfree((void*)PTE2PA(*pte));
+      *pte = 0;
     }
-    
-    *pte = 0;
   }
 }
 
-// create an empty user page table.
+// create an empty user page table, counted in *vc.
 // returns 0 if out of memory.
 pagetable_t
-uvmcreate()
+uvmcreate(struct vmcount *vc)
 {
   pagetable_t pagetable;
   pagetable = (pagetable_t) kalloc();
   if(pagetable == 0)
     return 0;
   memset(pagetable, 0, PGSIZE);
+  vc->ptpages++;
   return pagetable;
 }
 
@@ -211,7 +317,7 @@ uvmcreate()
 // for the very first process.
 // sz must be less than a page.
 void
-uvmfirst(pagetable_t pagetable, uchar *src, uint sz)
+uvmfirst(pagetable_t pagetable, uchar *src, uint sz, struct vmcount *vc)
 {
   char *mem;
 
@@ -219,14 +325,15 @@ uvmfirst(pagetable_t pagetable, uchar *src, uint sz)
     panic("uvmfirst: more than a page");
   mem = kalloc();
   memset(mem, 0, PGSIZE);
-  mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
+  mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U, vc);
   memmove(mem, src, sz);
 }
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
 uint64
-uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
+uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm,
+         struct vmcount *vc)
 {
   char *mem;
   uint64 a;
@@ -238,13 +345,13 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
   for(a = oldsz; a < newsz; a += PGSIZE){
     mem = kalloc();
     if(mem == 0){
-      uvmdealloc(pagetable, a, oldsz);
+      uvmdealloc(pagetable, a, oldsz, vc);
       return 0;
     }
     memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
+    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm, vc) != 0){
       kfree(mem);
-      uvmdealloc(pagetable, a, oldsz);
+      uvmdealloc(pagetable, a, oldsz, vc);
       return 0;
     }
   }
@@ -256,14 +363,14 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 // need to be less than oldsz.  oldsz can be larger than the actual
 // process size.  Returns the new process size.
 uint64
-uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, struct vmcount *vc)
 {
   if(newsz >= oldsz)
     return oldsz;
 
   if(PGROUNDUP(newsz) < PGROUNDUP(oldsz)){
     int npages = (PGROUNDUP(oldsz) - PGROUNDUP(newsz)) / PGSIZE;
-    uvmunmap(pagetable, PGROUNDUP(newsz), npages, 1);
+    uvmunmap(pagetable, PGROUNDUP(newsz), npages, 1, vc);
   }
 
   return newsz;
@@ -295,7 +402,7 @@ void
 uvmfree(pagetable_t pagetable, uint64 sz)
 {
   if(sz > 0)
-    uvmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1);
+    uvmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1, 0);
   freewalk(pagetable);
 }
 
@@ -306,7 +413,7 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
-uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+uvmcopy(pagetable_t old, pagetable_t new, uint64 sz, struct vmcount *vc)
 {
   pte_t *pte;
   uint64 pa, i;
@@ -320,10 +427,19 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
       panic("uvmcopy: page not present");
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
+    if(flags & PTE_S){
+      // a shared page stays shared: map the same frame.
+      if(mappages(new, i, PGSIZE, pa, flags, vc) != 0)
+        goto err;
+      kref((void*)pa);
+      continue;
+    }
+    if(flags & PTE_COW)
+      flags = (flags & ~PTE_COW) | PTE_W;  // the child's copy is private
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
+    if(mappages(new, i, PGSIZE, (uint64)mem, flags, vc) != 0){
       kfree(mem);
       goto err;
     }
@@ -331,7 +447,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, 0, i / PGSIZE, 1, vc);
   return -1;
 }
 
@@ -346,6 +462,157 @@ uvmclear(pagetable_t pagetable, uint64 va)
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
+  vmchanged(pagetable);
+}
+
+// Give the page at va a private, writable copy of its
+// contents if it is mapped copy-on-write. If no one else
+// refers to the page any more, just make it writable.
+// Returns 0 on success, including when another thread has
+// already made the page writable, or -1 if va is not a
+// copy-on-write page or memory is exhausted.
+int
+uvmcow(pagetable_t pagetable, uint64 va)
+{
+  struct spinlock *lk = cowhash(pagetable);
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+  acquire(lk);
+  if((pte = walk(pagetable, va, 0)) == 0 ||
+     (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U))
+    goto bad;
+  if(*pte & PTE_W){
+    release(lk);
+    return 0;
+  }
+  if((*pte & PTE_COW) == 0)
+    goto bad;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(krefcnt((void*)pa) == 1){
+    *pte = PA2PTE(pa) | flags;
+    vmchanged(pagetable);
+    release(lk);
+    return 0;
+  }
+  if((mem = kalloc()) == 0)
+    goto bad;
+  memmove(mem, (char*)pa, PGSIZE);
+  *pte = PA2PTE(mem) | flags;
+  vmchanged(pagetable);
+  release(lk);
+  kfree((void*)pa);
+  return 0;
+
+ bad:
+  release(lk);
+  return -1;
+}
+
+// Take a reference to the private page at va so that it can
+// be mapped elsewhere, write-protecting it here so that the
+// next write makes a copy. Returns the physical address,
+// or 0 if va is not a private user page.
+uint64
+uvmcowref(pagetable_t pagetable, uint64 va)
+{
+  struct spinlock *lk = cowhash(pagetable);
+  pte_t *pte;
+  uint64 pa;
+
+  if(va >= MAXVA)
+    return 0;
+  acquire(lk);
+  if((pte = walk(pagetable, va, 0)) == 0 ||
+     (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) || (*pte & PTE_S)){
+    release(lk);
+    return 0;
+  }
+  // a writable page with other references is mapped shared
+  // elsewhere, and must stay writable here.
+  if((*pte & PTE_W) && krefcnt((void*)PTE2PA(*pte)) > 1){
+    release(lk);
+    return 0;
+  }
+  if(*pte & PTE_W){
+    *pte = (*pte & ~PTE_W) | PTE_COW;
+    vmchanged(pagetable);
+  }
+  pa = PTE2PA(*pte);
+  kref((void*)pa);
+  release(lk);
+  return pa;
+}
+
+// Replace the private, writable page at va with pa, which is
+// mapped copy-on-write. Takes over the caller's reference to
+// pa and drops the reference to the old page.
+// Returns 0 on success, -1 if va is unsuitable, as when its
+// page is also mapped shared elsewhere (see uvmcowref()).
+int
+uvmcowmap(pagetable_t pagetable, uint64 va, uint64 pa)
+{
+  struct spinlock *lk = cowhash(pagetable);
+  pte_t *pte;
+  uint64 old;
+
+  if(va >= MAXVA)
+    return -1;
+  acquire(lk);
+  if((pte = walk(pagetable, va, 0)) == 0 ||
+     (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) || (*pte & PTE_S) ||
+     (*pte & (PTE_W|PTE_COW)) == 0 ||
+     ((*pte & PTE_W) && krefcnt((void*)PTE2PA(*pte)) > 1)){
+    release(lk);
+    return -1;
+  }
+  old = PTE2PA(*pte);
+  *pte = PA2PTE(pa) | ((PTE_FLAGS(*pte) & ~PTE_W) | PTE_COW);
+  vmchanged(pagetable);
+  release(lk);
+  kfree((void*)old);
+  return 0;
+}
+
+// Translate the user page at va0 for copyin/copyout, returning
+// its physical address and PTE flags, or 0 if it is not a
+// valid user page. Lookups in the current process's own page
+// table are cached for the rest of the system call.
+static uint64
+uvmxlate(pagetable_t pagetable, uint64 va0, uint *flags)
+{
+  struct proc *p = myproc();
+  struct ucache *c = 0;
+  uint64 gen;
+  pte_t *pte;
+
+  if(va0 >= MAXVA)
+    return 0;
+  gen = __atomic_load_n(&vmgen, __ATOMIC_ACQUIRE);
+  if(p && pagetable == p->pagetable){
+    c = &p->ucache[(va0 >> PGSHIFT) % NUCACHE];
+    if(c->gen == gen && c->va == va0){
+      *flags = c->flags;
+      return c->pa;
+    }
+  }
+  pte = walk(pagetable, va0, 0);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U))
+    return 0;
+  *flags = PTE_FLAGS(*pte);
+  if(c){
+    c->va = va0;
+    c->pa = PTE2PA(*pte);
+    c->flags = *flags;
+    c->gen = gen;
+  }
+  return PTE2PA(*pte);
 }
 
 // Copy from kernel to user.
@@ -355,12 +622,20 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  uint flags;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmxlate(pagetable, va0, &flags);
     if(pa0 == 0)
       return -1;
+    if(flags & PTE_COW){
+      if(uvmcow(pagetable, va0) < 0)
+        return -1;
+      continue;
+    }
+    if((flags & PTE_W) == 0)
+      return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -380,10 +655,11 @@ int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
+  uint flags;
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmxlate(pagetable, va0, &flags);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -398,6 +674,9 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
   return 0;
 }
 
+// Does the word have a zero byte?
+#define HASZERO(w) (((w) - 0x0101010101010101UL) & ~(w) & 0x8080808080808080UL)
+
 // Copy a null-terminated string from user to kernel.
 // Copy bytes to dst from virtual address srcva in a given page table,
 // until a '\0', or max.
@@ -405,64 +684,224 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
-  uint64 n, va0, pa0;
-  int got_null = 0;
+  uint64 n, va0, pa0, w;
+  uint flags;
+  char *p;
 
-  while(got_null == 0 && max > 0){
+  while(max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmxlate(pagetable, va0, &flags);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > max)
       n = max;
-
-    char *p = (char *) (pa0 + (srcva - va0));
-    while(n > 0){
-      if(*p == '\0'){
-        *dst = '\0';
-        got_null = 1;
-        break;
-      } else {
-        *dst = *p;
+    max -= n;
+    p = (char *) (pa0 + (srcva - va0));
+
+    // a byte at a time up to a word boundary, then whole words
+    // (which never cross the page) until one holds the '\0'.
+    for(; n > 0; n--, p++, dst++){
+      if(((uint64)p & 7) == 0 && n >= 8){
+        w = *(uint64*)p;
+        if(HASZERO(w) == 0){
+          if(((uint64)dst & 7) == 0)
+            *(uint64*)dst = w;
+          else
+            memmove(dst, p, 8);
+          p += 7, dst += 7, n -= 7;
+          continue;
+        }
       }
-      --n;
-      --max;
-      p++;
-      dst++;
+      if((*dst = *p) == '\0')
+        return 0;
     }
 
     srcva = va0 + PGSIZE;
   }
-  if(got_null){
-    return 0;
-  } else {
+  return -1;
+}
+
+// Shared mappings are kept in p->vma[], sorted by address,
+// in the leader of a group of threads.
+
+// Index of the vma holding va, or -1. Binary search.
+static int
+vmafind(struct proc *p, uint64 va)
+{
+  int lo = 0, hi = p->nvma - 1, mid;
+
+  while(lo <= hi){
+    mid = (lo + hi) / 2;
+    if(va < p->vma[mid].start)
+      hi = mid - 1;
+    else if(va >= p->vma[mid].end)
+      lo = mid + 1;
+    else
+      return mid;
+  }
+  return -1;
+}
+
+// Insert [start, end) as vma i, shifting the ones above up.
+static int
+vmainsert(struct proc *p, int i, uint64 start, uint64 end, int maxprot)
+{
+  if(p->nvma == NVMA)
     return -1;
+  memmove(&p->vma[i+1], &p->vma[i], (p->nvma - i) * sizeof(struct vma));
+  p->vma[i].start = start;
+  p->vma[i].end = end;
+  p->vma[i].maxprot = maxprot;
+  p->vma[i].f = 0;
+  p->vma[i].off = 0;
+  p->vma[i].flags = 0;
+  p->nvma++;
+  return 0;
+}
+
+// Find room for len bytes of shared mappings, as high as
+// possible, and record it. Returns the address, or 0.
+static uint64
+vmaalloc(struct proc *p, uint64 len, int maxprot)
+{
+  uint64 lo, hi = SHMTOP;
+
+  for(int i = p->nvma - 1; i >= -1; i--){
+    lo = i >= 0 ? p->vma[i].end : SHMBASE;
+    if(hi - lo >= len){
+      if(vmainsert(p, i + 1, hi - len, hi, maxprot) < 0)
+        return 0;
+      return hi - len;
+    }
+    if(i >= 0)
+      hi = p->vma[i].start;
+  }
+  return 0;
+}
+
+// Forget [start, end), which lies within one vma,
+// splitting it if need be. If that removes the whole vma of
+// a file mapping, its file is returned in *fp for the caller
+// to close once it has released p->lock, since closing may
+// sleep. Returns 0, or -1 if there is no room to split.
+static int
+vmaremove(struct proc *p, uint64 start, uint64 end, struct file **fp)
+{
+  int i = vmafind(p, start);
+  struct vma *v = &p->vma[i];
+
+  if(fp)
+    *fp = 0;
+  if(start > v->start && end < v->end){
+    if(vmainsert(p, i + 1, end, v->end, v->maxprot) < 0)
+      return -1;
+    v[1].f = v->f ? filedup(v->f) : 0;
+    v[1].off = v->off + (end - v->start);
+    v[1].flags = v->flags;
+    v->end = start;
+  } else if(start > v->start){
+    v->end = start;
+  } else if(end < v->end){
+    v->off += end - v->start;
+    v->start = end;
+  } else {
+    if(fp)
+      *fp = v->f;
+    memmove(v, v + 1, (p->nvma - i - 1) * sizeof(struct vma));
+    p->nvma--;
+  }
+  return 0;
+}
+
+// Remove all of p's shared mappings from pagetable, as
+// exit and exec do before freeing it. Their files have been
+// closed by vmaclose(), except after a failed fork, where the
+// parent still holds each one, so fileclose() cannot sleep.
+void
+vmaunmapall(struct proc *p, pagetable_t pagetable)
+{
+  for(int i = 0; i < p->nvma; i++){
+    uvmunmap(pagetable, p->vma[i].start, (p->vma[i].end - p->vma[i].start) / PGSIZE, 1, 0);
+    if(p->vma[i].f)
+      fileclose(p->vma[i].f);
+  }
+  p->nvma = 0;
+}
+
+// Give np the same shared mappings as p, of the same frames,
+// as fork does; pages of private file mappings become
+// copy-on-write in both. Returns 0, or -1 if out of memory.
+int
+vmacopy(struct proc *p, struct proc *np)
+{
+  struct spinlock *lk = cowhash(p->pagetable);
+  pte_t *pte;
+  uint64 a, pa;
+  int changed = 0;
+
+  acquire(lk);
+  for(int i = 0; i < p->nvma; i++){
+    for(a = p->vma[i].start; a < p->vma[i].end; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        panic("vmacopy: not mapped");
+      if((p->vma[i].flags & MAP_PRIVATE) && (*pte & PTE_W)){
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+        changed = 1;
+      }
+      pa = PTE2PA(*pte);
+      if(mappages(np->pagetable, a, PGSIZE, pa, PTE_FLAGS(*pte), &np->vm) != 0){
+        uvmunmap(np->pagetable, p->vma[i].start, (a - p->vma[i].start) / PGSIZE, 1, &np->vm);
+        if(changed)
+          vmchanged(p->pagetable);
+        release(lk);
+        return -1;
+      }
+      kref((void*)pa);
+    }
+    np->vma[i] = p->vma[i];
+    if(np->vma[i].f)
+      filedup(np->vma[i].f);
+    np->nvma = i + 1;
   }
+  if(changed)
+    vmchanged(p->pagetable);
+  release(lk);
+  return 0;
+}
+
+// PTE permission bits for PROT_ bits prot. Writable pages
+// must be readable too; without PTE_U, user code cannot use
+// the page at all.
+static int
+prot2perm(int prot)
+{
+  if(prot == PROT_NONE)
+    return PTE_R;
+  return PTE_R | PTE_U | ((prot & PROT_WRITE) ? PTE_W : 0);
 }
 
 uint64
-map_shared_pages(struct proc* src_proc, struct proc* dst_proc, uint64 src_user_va, uint64 size)
+map_shared_pages(struct proc* src_proc, struct proc* dst_proc, uint64 src_user_va, uint64 size, int prot)
 {
   uint64 src_page_aligned_start_va = PGROUNDDOWN(src_user_va);
   uint64 src_page_aligned_end_va = PGROUNDUP(src_user_va + size);
   uint64 offset_in_first_page = src_user_va - src_page_aligned_start_va;
   uint64 total_bytes_to_map_rounded = src_page_aligned_end_va - src_page_aligned_start_va;
 
-  if(size == 0 || total_bytes_to_map_rounded == 0) {
+  if(size == 0 || total_bytes_to_map_rounded == 0 || (prot & ~(PROT_READ|PROT_WRITE)) != 0) {
     return 0;
   }
 
-  // כתובת היעד למיפוי בתהליך היעד - בסוף מרחב הכתובות הנוכחי שלו
-  uint64 dst_mapping_start_va = PGROUNDUP(dst_proc->sz);
+  // the mapping goes in the shared region, at a free range
+  // recorded in dst's vmas; dst->sz is left alone.
+  uint64 dst_mapping_start_va = vmaalloc(dst_proc, total_bytes_to_map_rounded, prot);
+  if(dst_mapping_start_va == 0) {
+      return 0;
+  }
   // הכתובת שתחזור למשתמש (עם ה-offset המקורי)
   uint64 dst_va_returned_to_user = dst_mapping_start_va + offset_in_first_page;
 
-  // בדיקה אם יש מספיק מרחב כתובות וירטואלי בתהליך היעד
-  if (dst_mapping_start_va + total_bytes_to_map_rounded > MAXVA) { // MAXVA הוא הגבול העליון למרחב וירטואלי
-      return 0; 
-  }
-
   uint64 current_src_va = src_page_aligned_start_va;
   uint64 current_dst_va_for_mapping = dst_mapping_start_va;
 
@@ -471,45 +910,63 @@ map_shared_pages(struct proc* src_proc, struct proc* dst_proc, uint64 src_user_v
     pte_t *src_pte = walk(src_proc->pagetable, current_src_va, 0);
 
     // ודא שהדף במקור תקין, קיים, ונגיש למשתמש
-    if(src_pte == 0 || (*src_pte & PTE_V) == 0 || (*src_pte & PTE_U) == 0){
+    // (and writable, for a writable mapping)
+    if(src_pte == 0 || (*src_pte & PTE_V) == 0 || (*src_pte & PTE_U) == 0 ||
+       ((prot & PROT_WRITE) && (*src_pte & (PTE_W|PTE_COW)) == 0)){
       // אם יש כשל, בטל מיפויים שכבר בוצעו בלולאה זו בתהליך היעד
       if(current_dst_va_for_mapping > dst_mapping_start_va) {
-         uvmunmap(dst_proc->pagetable, dst_mapping_start_va, (current_dst_va_for_mapping - dst_mapping_start_va) / PGSIZE, 0);
+         uvmunmap(dst_proc->pagetable, dst_mapping_start_va, (current_dst_va_for_mapping - dst_mapping_start_va) / PGSIZE, 1, &dst_proc->vm);
       }
+      vmaremove(dst_proc, dst_mapping_start_va, dst_mapping_start_va + total_bytes_to_map_rounded, 0);
       return 0; // החזר כישלון
     }
 
+    // a copy-on-write page must get its own frame before it can be shared.
+    if((*src_pte & PTE_COW) && uvmcow(src_proc->pagetable, current_src_va) < 0){
+      if(current_dst_va_for_mapping > dst_mapping_start_va) {
+        uvmunmap(dst_proc->pagetable, dst_mapping_start_va, (current_dst_va_for_mapping - dst_mapping_start_va) / PGSIZE, 1, &dst_proc->vm);
+      }
+      vmaremove(dst_proc, dst_mapping_start_va, dst_mapping_start_va + total_bytes_to_map_rounded, 0);
+      return 0;
+    }
+
     uint64 phys_addr_to_map = PTE2PA(*src_pte); // קבל כתובת פיזית מהמקור
     // ודא שהכתובת הפיזית שהתקבלה תקינה (לא שלילית, בטווח הגיוני) - הוסף כאן בדיקה אם יש צורך.
     // לדוגמה, אם PTE2PA יכול להחזיר ערך מיוחד לשגיאה.
 
-    int dst_pte_flags = PTE_FLAGS(*src_pte) | PTE_S; // ירושה של הרשאות מהמקור + הוספת דגל משותף
+    // the source's flags, but with the permissions asked for
+    int dst_pte_flags = (PTE_FLAGS(*src_pte) & ~(PTE_R|PTE_W|PTE_U)) | prot2perm(prot) | PTE_S;
 
     // בצע את המיפוי בתהליך היעד
-    if(mappages(dst_proc->pagetable, current_dst_va_for_mapping, PGSIZE, phys_addr_to_map, dst_pte_flags) != 0){
+    if(mappages(dst_proc->pagetable, current_dst_va_for_mapping, PGSIZE, phys_addr_to_map, dst_pte_flags, &dst_proc->vm) != 0){
       // אם המיפוי נכשל, בטל מיפויים שכבר בוצעו
       if(current_dst_va_for_mapping > dst_mapping_start_va) {
-        uvmunmap(dst_proc->pagetable, dst_mapping_start_va, (current_dst_va_for_mapping - dst_mapping_start_va) / PGSIZE, 0);
+        uvmunmap(dst_proc->pagetable, dst_mapping_start_va, (current_dst_va_for_mapping - dst_mapping_start_va) / PGSIZE, 1, &dst_proc->vm);
       }
+      vmaremove(dst_proc, dst_mapping_start_va, dst_mapping_start_va + total_bytes_to_map_rounded, 0);
       return 0; // החזר כישלון
     }
+    // the frame now outlives whichever process unmaps it first.
+    kref((void*)phys_addr_to_map);
   }
 
-  // אם כל המיפויים הצליחו, עדכן את גודל תהליך היעד (dst_proc->sz)
-  // זהו השלב הקריטי שסביר שלא עבד נכון בגלל זיהוי שגוי של dst_proc קודם לכן.
-  dst_proc->sz = dst_mapping_start_va + total_bytes_to_map_rounded;
-
   return dst_va_returned_to_user; // החזר את הכתובת הרלוונטית למשתמש בתהליך היעד
 }
 
 uint64
-unmap_shared_pages(struct proc* p, uint64 addr, uint64 size)
+unmap_shared_pages(struct proc* p, uint64 addr, uint64 size, struct file **fp)
 {
   // Calculate page-aligned addresses
   uint64 start = PGROUNDDOWN(addr);
   uint64 end = PGROUNDUP(addr + size);
   uint64 npages = (end - start) / PGSIZE;
+  int i;
   
+  // The range must lie within one shared mapping
+  if(start >= end || (i = vmafind(p, start)) < 0 || end > p->vma[i].end) {
+    return -1;
+  }
+
   // Verify these are valid shared pages
   for(uint64 a = start; a < end; a += PGSIZE) {
     pte_t *pte = walk(p->pagetable, a, 0);
@@ -521,13 +978,187 @@ unmap_shared_pages(struct proc* p, uint64 addr, uint64 size)
     }
   }
   
-  // Unmap the pages without freeing physical memory (do_free=0)
-  uvmunmap(p->pagetable, start, npages, 0);
-  
-  // Update process size if unmapping at the end of address space
-  if(end == p->sz) {
-    p->sz = start;
+  // Splitting a mapping needs a free vma
+  if(vmaremove(p, start, end, fp) < 0) {
+    return -1;
   }
+
+  // Unmap the pages, dropping this mapping's references
+  uvmunmap(p->pagetable, start, npages, 1, &p->vm);
   
   return 0;
 }
+
+// Set the protection of shared pages [addr, addr+len), which
+// must lie within one mapping, to prot, no more than it was
+// mapped with. Returns 0, or -1.
+int
+vmaprotect(struct proc *p, uint64 addr, uint64 len, int prot)
+{
+  uint64 a, start = PGROUNDDOWN(addr), end = PGROUNDUP(addr + len);
+  struct spinlock *lk = cowhash(p->pagetable);
+  pte_t *pte;
+  int i, perm;
+
+  if(start >= end || (i = vmafind(p, start)) < 0 || end > p->vma[i].end)
+    return -1;
+  if((prot & ~p->vma[i].maxprot) != 0)
+    return -1;
+  acquire(lk);
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      panic("vmaprotect");
+    perm = prot2perm(prot);
+    // a private page that is not yet our own copy.
+    if((p->vma[i].flags & MAP_PRIVATE) && (perm & PTE_W) && krefcnt((void*)PTE2PA(*pte)) > 1)
+      perm = (perm & ~PTE_W) | PTE_COW;
+    *pte = (*pte & ~(PTE_R|PTE_W|PTE_U|PTE_COW)) | perm;
+  }
+  vmchanged(p->pagetable);
+  release(lk);
+  return 0;
+}
+
+// PROT_ bits for the permissions in pte; the inverse of prot2perm().
+static int
+perm2prot(pte_t pte)
+{
+  if((pte & PTE_U) == 0)
+    return PROT_NONE;
+  return PROT_READ | ((pte & (PTE_W|PTE_COW)) ? PROT_WRITE : 0);
+}
+
+// Describe p's memory in *si, which the caller has zeroed.
+// Caller holds p->lock.
+void
+vmainfo(struct proc *p, struct shminfo *si)
+{
+  struct shmseg *s;
+  pte_t *pte;
+  uint64 a;
+  int i, ref;
+
+  si->sz = p->sz;
+  si->heappages = p->vm.private;
+  si->shmpages = p->vm.shared;
+  si->ptpages = p->vm.ptpages;
+  si->peakpages = p->vm.peak;
+  for(a = 0; a < p->sz; a += PGSIZE){
+    if((pte = walk(p->pagetable, a, 0)) != 0 && (*pte & (PTE_V|PTE_COW)) == (PTE_V|PTE_COW))
+      si->cowpages++;
+  }
+
+  si->nseg = p->nvma;
+  for(i = 0; i < p->nvma; i++){
+    s = &si->seg[i];
+    s->start = p->vma[i].start;
+    s->end = p->vma[i].end;
+    s->maxprot = p->vma[i].maxprot;
+    s->flags = p->vma[i].flags;
+    for(a = s->start; a < s->end; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        panic("vmainfo");
+      if(a == s->start)
+        s->prot = perm2prot(*pte);
+      ref = krefcnt((void*)PTE2PA(*pte));
+      s->npages++;
+      s->refs += ref;
+      if(ref > s->maxref)
+        s->maxref = ref;
+    }
+  }
+}
+
+// Map the n frames in pa[], page n of file f at off, at a
+// free place in p's shared region, taking over the caller's
+// references to them, for mmap(). A private mapping may not
+// write the frames, which belong to the page cache, so its
+// writable pages start out copy-on-write. Returns the address,
+// or 0. Caller holds p->lock.
+uint64
+vmammap(struct proc *p, uint64 *pa, int n, struct file *f, uint64 off,
+        int prot, int maxprot, int flags)
+{
+  struct vma *v;
+  uint64 va;
+  int i, perm;
+
+  perm = prot2perm(prot) | PTE_S;
+  if(flags == MAP_PRIVATE && (perm & PTE_W))
+    perm = (perm & ~PTE_W) | PTE_COW;
+  if((va = vmaalloc(p, (uint64)n * PGSIZE, maxprot)) == 0){
+    for(i = 0; i < n; i++)
+      kfree((void*)pa[i]);
+    return 0;
+  }
+  for(i = 0; i < n; i++){
+    if(mappages(p->pagetable, va + i*PGSIZE, PGSIZE, pa[i], perm, &p->vm) != 0){
+      uvmunmap(p->pagetable, va, i, 1, &p->vm);
+      vmaremove(p, va, va + (uint64)n * PGSIZE, 0);
+      for(; i < n; i++)
+        kfree((void*)pa[i]);
+      return 0;
+    }
+  }
+  v = &p->vma[vmafind(p, va)];
+  v->f = filedup(f);
+  v->off = off;
+  v->flags = flags;
+  return va;
+}
+
+// Write the pages of p's writable shared file mappings in
+// [start, end) back to their files. Writing sleeps, so this
+// is called without p->lock, and takes it for each page.
+void
+vmaflush(struct proc *p, uint64 start, uint64 end)
+{
+  struct vma *v;
+  struct file *f;
+  pte_t *pte;
+  uint64 a, off, pa;
+  int i;
+
+  for(a = PGROUNDDOWN(start); a < end; a += PGSIZE){
+    acquire(&p->lock);
+    if((i = vmafind(p, a)) < 0){
+      release(&p->lock);
+      continue;
+    }
+    v = &p->vma[i];
+    if(v->f == 0 || v->flags != MAP_SHARED || (v->maxprot & PROT_WRITE) == 0 ||
+       (pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0){
+      release(&p->lock);
+      continue;
+    }
+    f = filedup(v->f);
+    off = v->off + (a - v->start);
+    pa = PTE2PA(*pte);
+    kref((void*)pa);
+    release(&p->lock);
+
+    pcwriteback(f, off, pa);
+    kfree((void*)pa);
+    fileclose(f);
+  }
+}
+
+// Flush p's file mappings and close their files, as exit and
+// exec do before the mappings themselves go. p has no other
+// threads, so p->vma[] cannot change underneath.
+void
+vmaclose(struct proc *p)
+{
+  struct file *f;
+
+  for(int i = 0; i < p->nvma; i++){
+    if(p->vma[i].f == 0)
+      continue;
+    vmaflush(p, p->vma[i].start, p->vma[i].end);
+    acquire(&p->lock);
+    f = p->vma[i].f;
+    p->vma[i].f = 0;
+    release(&p->lock);
+    fileclose(f);
+  }
+}
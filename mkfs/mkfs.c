@@ -40,6 +40,8 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void dirappend(uint dir, char *name, uint inum);
+uint makedir(uint parent, char *name);
 void die(const char *);
 
 // convert to riscv byte order
@@ -68,10 +70,10 @@ xint(uint x)
 int
 main(int argc, char *argv[])
 {
-  int i, cc, fd;
-  uint rootino, inum, off;
+  int i, cc, fd, len;
+  uint rootino, symino, dir, inum, off;
   struct dirent de;
-  char buf[BSIZE];
+  char buf[BSIZE], name[DIRSIZ+1];
   struct dinode din;
 
 
@@ -127,11 +129,14 @@ main(int argc, char *argv[])
   strcpy(de.name, "..");
   iappend(rootino, &de, sizeof(de));
 
+  symino = 0;
   for(i = 2; i < argc; i++){
-    // get rid of "user/"
+    // get rid of "user/" or "kernel/"
     char *shortname;
     if(strncmp(argv[i], "user/", 5) == 0)
       shortname = argv[i] + 5;
+    else if(strncmp(argv[i], "kernel/", 7) == 0)
+      shortname = argv[i] + 7;
     else
       shortname = argv[i];
     
@@ -147,12 +152,21 @@ main(int argc, char *argv[])
     if(shortname[0] == '_')
       shortname += 1;
 
-    inum = ialloc(T_FILE);
+    // Symbol tables for prof go in /sym, as sym/prog: prog.sym
+    // would be cut to the same DIRSIZ characters as the name
+    // of a program with a long one.
+    dir = rootino;
+    len = strlen(shortname);
+    if(len > 4 && strcmp(shortname + len - 4, ".sym") == 0){
+      if(symino == 0)
+        symino = makedir(rootino, "sym");
+      dir = symino;
+      snprintf(name, sizeof(name), "%.*s", len - 4, shortname);
+      shortname = name;
+    }
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    inum = ialloc(T_FILE);
+    dirappend(dir, shortname, inum);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -160,12 +174,14 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  // fix size of root inode dir, and of sym
+  for(dir = rootino; dir != 0; dir = dir == rootino ? symino : 0){
+    rinode(dir, &din);
+    off = xint(din.size);
+    off = ((off/BSIZE) + 1) * BSIZE;
+    din.size = xint(off);
+    winode(dir, &din);
+  }
 
   balloc(freeblock);
 
@@ -293,6 +309,57 @@ iappend(uint inum, void *xp, int n)
   winode(inum, &din);
 }
 
+// Names already in each directory, to catch two files whose
+// names are the same once cut to DIRSIZ characters.
+struct {
+  uint dir;
+  char name[DIRSIZ];
+} names[NINODES];
+int nnames;
+
+// Add an entry called name for inum to directory dir.
+void
+dirappend(uint dir, char *name, uint inum)
+{
+  struct dirent de;
+  int i;
+
+  for(i = 0; i < nnames; i++){
+    if(names[i].dir == dir && strncmp(names[i].name, name, DIRSIZ) == 0){
+      fprintf(stderr, "mkfs: %s: same name as another file once cut to %d characters\n",
+              name, DIRSIZ);
+      exit(1);
+    }
+  }
+  assert(nnames < NINODES);
+  names[nnames].dir = dir;
+  strncpy(names[nnames].name, name, DIRSIZ);
+  nnames++;
+
+  bzero(&de, sizeof(de));
+  de.inum = xshort(inum);
+  strncpy(de.name, name, DIRSIZ);
+  iappend(dir, &de, sizeof(de));
+}
+
+// Make a directory called name in parent, and return its inum.
+uint
+makedir(uint parent, char *name)
+{
+  uint inum = ialloc(T_DIR);
+  struct dinode din;
+
+  dirappend(inum, ".", inum);
+  dirappend(inum, "..", parent);
+  dirappend(parent, name, inum);
+
+  // the new directory's ".." links to parent.
+  rinode(parent, &din);
+  din.nlink = xshort(xshort(din.nlink) + 1);
+  winode(parent, &din);
+  return inum;
+}
+
 void
 die(const char *s)
 {
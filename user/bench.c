@@ -0,0 +1,401 @@
+// bench: microbenchmark suite.
+//
+//   bench [-q] [group...]
+//
+// Runs the benchmarks in each group named, or in all of them:
+//   null   getpid(), clock_gettime() and nsecs()
+//   fork   fork+exit+wait, and fork+exec+wait
+//   pipe   pipe bandwidth, and one-byte ping-pong
+//   fs     file create, read and unlink; big file write, read
+//   shm    map_shared_pages() and unmap_shared_pages() by size
+//   ring   shmlog records through a shared ring, by writers
+// and prints a line for each result:
+//   BENCH name value unit
+// Units ending in "/s" are rates, where more is better; "ns"
+// and "us" are times, where less is. Each timed loop runs for
+// at least 200ms, or 50ms with -q. Everything else goes to
+// the console's fd 2, so the results are easy to pick out.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/shmlog.h"
+
+#define PGSIZE 4096
+#define MAXSHM (64*PGSIZE)
+#define BIGFILE (256*1024)
+#define RINGBYTES (4*PGSIZE)
+
+int mintime = 200;            // milliseconds each timed loop runs
+int pipebytes = 8*1024*1024;  // bytes through the pipe
+int nfiles = 100;             // small files created
+char buf[8192];
+char *shm;                    // MAXSHM bytes to share
+struct shmlog *ring;
+
+void
+fail(char *msg)
+{
+  fprintf(2, "bench: %s\n", msg);
+  exit(1);
+}
+
+void
+result(char *name, uint64 value, char *unit)
+{
+  printf("BENCH %s %l %s\n", name, value, unit);
+}
+
+// name with a number in it, such as "shm.map.4K".
+char*
+numname(char *prefix, int n, char *suffix)
+{
+  static char name[32];
+  char digits[12];
+  int i, j;
+
+  strcpy(name, prefix);
+  j = strlen(name);
+  i = 0;
+  do {
+    digits[i++] = '0' + n % 10;
+    n /= 10;
+  } while(n > 0);
+  while(i > 0)
+    name[j++] = digits[--i];
+  strcpy(name + j, suffix);
+  return name;
+}
+
+// run fn(arg, 0) until mintime has passed; fn returns how
+// many operations it did. Returns nanoseconds per operation.
+uint64
+timeit(int (*fn)(int, int), int arg)
+{
+  uint64 r = benchrate(fn, arg, 0, mintime);
+
+  return r ? 1000000000 / r : 0;
+}
+
+// bytes per nanoseconds, in KB/s.
+uint64
+kbps(uint64 bytes, uint64 ns)
+{
+  return ns ? bytes * 1000000000 / 1024 / ns : 0;
+}
+
+int
+dogetpid(int unused, int unused2)
+{
+  for(int i = 0; i < 100; i++)
+    getpid();
+  return 100;
+}
+
+int
+doclock(int unused, int unused2)
+{
+  for(int i = 0; i < 100; i++)
+    clock_gettime();
+  return 100;
+}
+
+int
+donsecs(int unused, int unused2)
+{
+  for(int i = 0; i < 100; i++)
+    nsecs();
+  return 100;
+}
+
+void
+nullbench(void)
+{
+  result("null.getpid", timeit(dogetpid, 0), "ns");
+  result("null.clock_gettime", timeit(doclock, 0), "ns");
+  result("null.nsecs", timeit(donsecs, 0), "ns");
+}
+
+int
+doforkexit(int unused, int unused2)
+{
+  int pid;
+
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0)
+    exit(0);
+  wait(0);
+  return 1;
+}
+
+int
+doforkexec(int unused, int unused2)
+{
+  char *argv[] = { "bench", "-x", 0 };
+  int pid;
+
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    exec("bench", argv);
+    fail("exec failed");
+  }
+  wait(0);
+  return 1;
+}
+
+void
+forkbench(void)
+{
+  result("fork.exit", timeit(doforkexit, 0) / 1000, "us");
+  result("fork.exec", timeit(doforkexec, 0) / 1000, "us");
+}
+
+int pingfd[2], pongfd[2];
+
+int
+dopingpong(int unused, int unused2)
+{
+  for(int i = 0; i < 100; i++){
+    if(write(pingfd[1], buf, 1) != 1 || read(pongfd[0], buf, 1) != 1)
+      fail("ping-pong failed");
+  }
+  return 100;
+}
+
+void
+pipebench(void)
+{
+  int fds[2], pid, n, m;
+  uint64 t0;
+
+  // a child writes pipebytes in 4096-byte chunks.
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  t0 = nsecs();
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    close(fds[0]);
+    for(n = 0; n < pipebytes; n += 4096)
+      if(write(fds[1], buf, 4096) != 4096)
+        fail("pipe write failed");
+    exit(0);
+  }
+  close(fds[1]);
+  for(n = 0; n < pipebytes; n += m)
+    if((m = read(fds[0], buf, 4096)) <= 0)
+      fail("pipe read failed");
+  close(fds[0]);
+  wait(0);
+  result("pipe.bw", kbps(pipebytes, nsecs() - t0), "KB/s");
+
+  // a child echoes each byte back.
+  if(pipe(pingfd) < 0 || pipe(pongfd) < 0)
+    fail("pipe failed");
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    close(pingfd[1]);
+    close(pongfd[0]);
+    while(read(pingfd[0], buf, 1) == 1)
+      write(pongfd[1], buf, 1);
+    exit(0);
+  }
+  close(pingfd[0]);
+  close(pongfd[1]);
+  result("pipe.pingpong", timeit(dopingpong, 0), "ns");
+  close(pingfd[1]);
+  close(pongfd[0]);
+  wait(0);
+}
+
+void
+fsbench(void)
+{
+  int i, fd, n;
+  uint64 t0;
+
+  // nfiles small files, 1024 bytes each.
+  t0 = nsecs();
+  for(i = 0; i < nfiles; i++){
+    if((fd = open(numname("benchf", i, ""), O_CREATE|O_TRUNC|O_WRONLY)) < 0 || write(fd, buf, 1024) != 1024)
+      fail("cannot create file");
+    close(fd);
+  }
+  result("fs.create", (nsecs() - t0) / nfiles / 1000, "us");
+
+  t0 = nsecs();
+  for(i = 0; i < nfiles; i++){
+    if((fd = open(numname("benchf", i, ""), O_RDONLY)) < 0 || read(fd, buf, 1024) != 1024)
+      fail("cannot read file");
+    close(fd);
+  }
+  result("fs.read", (nsecs() - t0) / nfiles / 1000, "us");
+
+  t0 = nsecs();
+  for(i = 0; i < nfiles; i++){
+    if(unlink(numname("benchf", i, "")) < 0)
+      fail("cannot unlink file");
+  }
+  result("fs.unlink", (nsecs() - t0) / nfiles / 1000, "us");
+
+  // one big file, in 4096-byte writes and reads.
+  t0 = nsecs();
+  if((fd = open("benchbig", O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+    fail("cannot create file");
+  for(n = 0; n < BIGFILE; n += 4096)
+    if(write(fd, buf, 4096) != 4096)
+      fail("cannot write file");
+  close(fd);
+  result("fs.write.bw", kbps(BIGFILE, nsecs() - t0), "KB/s");
+
+  t0 = nsecs();
+  if((fd = open("benchbig", O_RDONLY)) < 0)
+    fail("cannot open file");
+  for(n = 0; n < BIGFILE; n += 4096)
+    if(read(fd, buf, 4096) != 4096)
+      fail("cannot read file");
+  close(fd);
+  result("fs.read.bw", kbps(BIGFILE, nsecs() - t0), "KB/s");
+  unlink("benchbig");
+}
+
+uint64 maptime, unmaptime;
+int nmaps;
+
+int
+domap(int size, int unused)
+{
+  uint64 t0, t1, t2;
+  char *p;
+
+  t0 = nsecs();
+  if((p = (char*)map_shared_pages(getpid(), shm, size, PROT_READ|PROT_WRITE)) == 0)
+    fail("map_shared_pages failed");
+  t1 = nsecs();
+  if(unmap_shared_pages(p, size) < 0)
+    fail("unmap_shared_pages failed");
+  t2 = nsecs();
+  maptime += t1 - t0;
+  unmaptime += t2 - t1;
+  nmaps++;
+  return 1;
+}
+
+void
+shmbench(void)
+{
+  int size;
+
+  for(size = PGSIZE; size <= MAXSHM; size *= 4){
+    maptime = unmaptime = 0;
+    nmaps = 0;
+    timeit(domap, size);
+    result(numname("shm.map.", size / 1024, "K"), maptime / nmaps, "ns");
+    result(numname("shm.unmap.", size / 1024, "K"), unmaptime / nmaps, "ns");
+  }
+}
+
+// a writer process: map the parent's ring and append n
+// records of 32 bytes.
+void
+ringwriter(int parent, int w, int n)
+{
+  struct shmlog *lg;
+
+  lg = (struct shmlog*)map_shared_pages(parent, ring, RINGBYTES, PROT_READ|PROT_WRITE);
+  if(lg == 0)
+    fail("map_shared_pages failed");
+  for(int i = 0; i < n; i++)
+    if(shmlog_write(lg, w, buf, 32) < 0)
+      fail("shmlog_write failed");
+  exit(0);
+}
+
+void
+ringbench(void)
+{
+  int nw, w, got, n, pid, parent;
+  uint64 t0;
+
+  parent = getpid();
+  n = pipebytes / 1024;
+  for(nw = 1; nw <= 4; nw *= 2){
+    t0 = nsecs();
+    for(w = 0; w < nw; w++){
+      if((pid = fork()) < 0)
+        fail("fork failed");
+      if(pid == 0)
+        ringwriter(parent, w, n);
+    }
+    for(got = 0; got < nw * n; )
+      if(shmlog_read(ring, &w, buf, sizeof(buf)) >= 0)
+        got++;
+    for(w = 0; w < nw; w++)
+      wait(0);
+    result(numname("ring.writers", nw, ""), got * 1000000000ULL / (nsecs() - t0), "rec/s");
+  }
+}
+
+struct group {
+  char *name;
+  void (*fn)(void);
+} groups[] = {
+  { "null", nullbench },
+  { "fork", forkbench },
+  { "pipe", pipebench },
+  { "fs", fsbench },
+  { "shm", shmbench },
+  { "ring", ringbench },
+};
+
+#define NGROUP (sizeof(groups)/sizeof(groups[0]))
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, first;
+  char *p;
+
+  // fork.exec runs this.
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit(0);
+
+  first = 1;
+  if(argc > 1 && strcmp(argv[1], "-q") == 0){
+    mintime /= 4;
+    pipebytes /= 4;
+    nfiles /= 4;
+    first = 2;
+  }
+
+  if((p = sbrk(MAXSHM + RINGBYTES + PGSIZE)) == (char*)-1)
+    fail("sbrk failed");
+  shm = (char*)(((uint64)p + PGSIZE - 1) & ~(PGSIZE - 1L));
+  memset(shm, 'x', MAXSHM);
+  if((ring = shmlog_init(shm + MAXSHM, RINGBYTES)) == 0)
+    fail("shmlog_init failed");
+
+  for(j = first; j < argc; j++){
+    for(i = 0; i < NGROUP; i++)
+      if(strcmp(argv[j], groups[i].name) == 0)
+        break;
+    if(i == NGROUP){
+      fprintf(2, "usage: bench [-q] [null fork pipe fs shm ring]\n");
+      exit(1);
+    }
+  }
+
+  for(i = 0; i < NGROUP; i++){
+    for(j = first; j < argc; j++)
+      if(strcmp(argv[j], groups[i].name) == 0)
+        break;
+    if(first == argc || j < argc){
+      fprintf(2, "bench: %s\n", groups[i].name);
+      groups[i].fn();
+    }
+  }
+  exit(0);
+}
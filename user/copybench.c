@@ -0,0 +1,77 @@
+// copybench: cost of copying system call arguments.
+//
+//   copybench [ms]
+//
+// Each test runs for ms (default 2000) milliseconds and
+// reports the rate it achieved:
+//   pipe N     write N bytes into a pipe and read them back,
+//              which is one copyin() and one copyout();
+//   pipe N+1   the same from a misaligned buffer;
+//   path N     open() a nonexistent N-byte path, which is
+//              mostly copyinstr().
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PIPESIZE 2048  // kernel/pipe.c
+
+char buf[PIPESIZE + 8];
+char path[128];
+int fds[2];
+int ms;
+
+int sizes[] = { 8, 64, 512, 2048 };
+
+int
+pipeio(int size, int off)
+{
+  if(write(fds[1], buf + off, size) != size || read(fds[0], buf + off, size) != size){
+    fprintf(2, "copybench: pipe i/o failed\n");
+    exit(1);
+  }
+  return 1;
+}
+
+int
+openpath(int size, int off)
+{
+  if(open(path + sizeof(path) - 1 - size, O_RDONLY) >= 0){
+    fprintf(2, "copybench: %s exists\n", path);
+    exit(1);
+  }
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+  uint64 r;
+
+  ms = argc > 1 ? atoi(argv[1]) : 2000;
+  if(ms < 1){
+    fprintf(2, "usage: copybench [ms]\n");
+    exit(1);
+  }
+  if(pipe(fds) < 0){
+    fprintf(2, "copybench: pipe failed\n");
+    exit(1);
+  }
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    r = benchrate(pipeio, sizes[i], 0, ms);
+    printf("pipe %d: %l round trips/s, %l KB/s\n", sizes[i], r, r * sizes[i] / 1024);
+    r = benchrate(pipeio, sizes[i], 1, ms);
+    printf("pipe %d+1: %l round trips/s, %l KB/s\n", sizes[i], r, r * sizes[i] / 1024);
+  }
+
+  // a path of x's with a '/' every 13 bytes, so no name is too long.
+  for(i = 0; i < sizeof(path) - 1; i++)
+    path[i] = i % 14 == 13 ? '/' : 'x';
+  for(i = 16; i < sizeof(path); i *= 2){
+    r = benchrate(openpath, i - 1, 0, ms);
+    printf("path %d: %l opens/s\n", i - 1, r);
+  }
+  exit(0);
+}
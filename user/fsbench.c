@@ -0,0 +1,100 @@
+// fsbench: cost of reading cached files and of exec.
+//
+//   fsbench [ms]
+//
+// Each test runs for ms (default 2000) milliseconds and
+// reports the rate it achieved:
+//   read N     read a whole N-byte file, already cached,
+//              in 4096-byte read()s;
+//   read N/B   the same in B-byte read()s;
+//   exec       fork, then exec this program, which exits
+//              at once, and wait for it.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define MAXFILE 65536
+
+char *name = "fsbench.tmp";
+char buf[4096];
+int ms;
+
+int sizes[] = { 4096, 16384, MAXFILE };
+
+int
+readfile(int size, int bsize)
+{
+  int fd, n, tot;
+
+  if((fd = open(name, O_RDONLY)) < 0){
+    fprintf(2, "fsbench: cannot open %s\n", name);
+    exit(1);
+  }
+  tot = 0;
+  while(tot < size && (n = read(fd, buf, bsize)) > 0)
+    tot += n;
+  close(fd);
+  if(tot != size){
+    fprintf(2, "fsbench: short read\n");
+    exit(1);
+  }
+  return 1;
+}
+
+int
+execself(int unused, int unused2)
+{
+  char *argv[] = { "fsbench", "-x", 0 };
+  int pid;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "fsbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec("fsbench", argv);
+    fprintf(2, "fsbench: exec failed\n");
+    exit(1);
+  }
+  wait(0);
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, fd, n;
+  uint64 r;
+
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit(0);
+  ms = argc > 1 ? atoi(argv[1]) : 2000;
+  if(ms < 1){
+    fprintf(2, "usage: fsbench [ms]\n");
+    exit(1);
+  }
+
+  memset(buf, 'x', sizeof(buf));
+  if((fd = open(name, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(2, "fsbench: cannot create %s\n", name);
+    exit(1);
+  }
+  for(n = 0; n < MAXFILE; n += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "fsbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    r = benchrate(readfile, sizes[i], sizeof(buf), ms);
+    printf("read %d: %l files/s, %l KB/s\n", sizes[i], r, r * (sizes[i] / 1024));
+  }
+  r = benchrate(readfile, MAXFILE, 512, ms);
+  printf("read %d/512: %l files/s, %l KB/s\n", MAXFILE, r, r * (MAXFILE / 1024));
+  printf("exec: %l/s\n", benchrate(execself, 0, 0, ms));
+  unlink(name);
+  exit(0);
+}
@@ -0,0 +1,153 @@
+// futexbench: waiting on shared memory with futexes vs spinning.
+//
+//   futexbench [ticks]
+//
+// pingpong: two processes sharing a page take turns flipping
+// a word, each waiting for the other's flip either by spinning
+// or in futex_wait(); reports round trips per tick.
+//
+// idle: a consumer waits for a producer that posts once per
+// tick, while NMETER processes count loop iterations; the
+// count shows how much CPU the waiting consumer leaves for
+// others.
+//
+// Each test runs for ticks (default 20) clock ticks.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define NMETER 3
+
+struct shared {
+  int turn;             // pingpong: whose turn it is
+  int seq;              // idle: messages posted
+  int stop;             // tell everyone to finish
+  uint64 count[NMETER]; // iterations by each meter
+};
+
+struct shared *sh;
+int ticks;
+
+// The other process's view of the parent's page.
+struct shared*
+attach(int parent)
+{
+  struct shared *s = (struct shared*)map_shared_pages(parent, sh, PGSIZE, PROT_READ|PROT_WRITE);
+
+  if(s == 0){
+    fprintf(2, "futexbench: map_shared_pages failed\n");
+    exit(1);
+  }
+  return s;
+}
+
+// wait until *w != v.
+void
+waitne(int *w, int v, int usefutex)
+{
+  while(__atomic_load_n(w, __ATOMIC_ACQUIRE) == v)
+    if(usefutex)
+      futex_wait(w, v);
+}
+
+void
+post(int *w, int v, int usefutex)
+{
+  __atomic_store_n(w, v, __ATOMIC_RELEASE);
+  if(usefutex)
+    futex_wake(w, 1);
+}
+
+void
+pingpong(int usefutex)
+{
+  int parent = getpid(), pid, n, t0;
+  struct shared *s;
+
+  sh->turn = 0;
+  sh->stop = 0;
+  if((pid = fork()) == 0){
+    s = attach(parent);
+    for(;;){
+      waitne(&s->turn, 0, usefutex);
+      if(s->stop)
+        exit(0);
+      post(&s->turn, 0, usefutex);
+    }
+  }
+  t0 = uptime();
+  // check the time only every 64 round trips.
+  for(n = 0; (n & 63) != 0 || uptime() - t0 < ticks; n++){
+    post(&sh->turn, 1, usefutex);
+    waitne(&sh->turn, 1, usefutex);
+  }
+  sh->stop = 1;
+  post(&sh->turn, 1, usefutex);
+  wait(0);
+  printf("pingpong %s: %d round trips/tick\n", usefutex ? "futex" : "spin ", n / ticks);
+}
+
+void
+idle(int usefutex)
+{
+  int parent = getpid(), i, pid, t0, seen;
+  uint64 total;
+  struct shared *s;
+
+  sh->seq = 0;
+  sh->stop = 0;
+  for(i = 0; i < NMETER; i++){
+    sh->count[i] = 0;
+    if(fork() == 0){
+      s = attach(parent);
+      while(__atomic_load_n(&s->stop, __ATOMIC_RELAXED) == 0)
+        s->count[i]++;
+      exit(0);
+    }
+  }
+  if((pid = fork()) == 0){
+    s = attach(parent);
+    for(seen = 0; ; seen++){
+      waitne(&s->seq, seen, usefutex);
+      if(s->stop)
+        exit(0);
+    }
+  }
+  t0 = uptime();
+  while(uptime() - t0 < ticks){
+    sleep(1);
+    post(&sh->seq, sh->seq + 1, usefutex);
+  }
+  sh->stop = 1;
+  post(&sh->seq, sh->seq + 1, usefutex);
+  for(i = 0; i < NMETER + 1; i++)
+    wait(0);
+  total = 0;
+  for(i = 0; i < NMETER; i++)
+    total += sh->count[i];
+  printf("idle %s: meters ran %l iterations/tick\n", usefutex ? "futex" : "spin ", total / ticks);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *p;
+
+  ticks = argc > 1 ? atoi(argv[1]) : 20;
+  if(ticks < 1){
+    fprintf(2, "usage: futexbench [ticks]\n");
+    exit(1);
+  }
+  if((p = sbrk(2 * PGSIZE)) == (char*)-1){
+    fprintf(2, "futexbench: sbrk failed\n");
+    exit(1);
+  }
+  sh = (struct shared*)(((uint64)p + PGSIZE - 1) & ~(PGSIZE - 1L));
+  pingpong(0);
+  pingpong(1);
+  idle(0);
+  idle(1);
+  exit(0);
+}
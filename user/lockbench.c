@@ -0,0 +1,140 @@
+// lockbench: kernel lock stress test.
+//
+//   lockbench [-f] [maxworkers] [ticks]
+//
+// For 1..maxworkers (default 8) concurrent processes, each
+// process spends ticks clock ticks (default 10) growing and
+// shrinking its memory by a page, which takes and releases
+// the kmem lock twice per iteration. With -f the processes
+// fork and reap children instead, which also exercises
+// wait_lock and the proc locks. Prints total iterations per
+// tick and, on a LOCKSTAT=1 kernel, the longest kmem wait.
+//
+// Run qemu with CPUS=8 to get 8 harts; compare a default
+// kernel against TICKETLOCK=1.
+
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat st[NLOCKCLASS];
+
+int
+iterate(int forkmode)
+{
+  int pid;
+
+  if(forkmode){
+    if((pid = fork()) < 0)
+      return -1;
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  } else {
+    if(sbrk(4096) == (char*)-1)
+      return -1;
+    sbrk(-4096);
+  }
+  return 0;
+}
+
+// run one round with n workers; returns total iterations.
+int
+round(int n, int ticks, int forkmode)
+{
+  int i, pid, total, count, end;
+  int go[2], done[2];
+
+  if(pipe(go) < 0 || pipe(done) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(go[1]);
+      close(done[0]);
+      if(read(go[0], &end, sizeof(end)) != sizeof(end))
+        exit(1);
+      count = 0;
+      while(uptime() < end){
+        if(iterate(forkmode) < 0)
+          break;
+        count++;
+      }
+      write(done[1], &count, sizeof(count));
+      exit(0);
+    }
+  }
+  close(go[0]);
+  close(done[1]);
+
+  // start all workers together, at the next tick boundary.
+  end = uptime() + 1;
+  while(uptime() < end)
+    ;
+  end += ticks;
+  for(i = 0; i < n; i++)
+    write(go[1], &end, sizeof(end));
+  close(go[1]);
+
+  total = 0;
+  for(i = 0; i < n; i++){
+    if(read(done[0], &count, sizeof(count)) == sizeof(count))
+      total += count;
+  }
+  close(done[0]);
+  for(i = 0; i < n; i++)
+    wait(0);
+  return total;
+}
+
+// longest wait for the named lock, or -1 if unavailable.
+int
+maxwait(char *name)
+{
+  int i, n;
+
+  if((n = lockstat(LS_READ, st, NLOCKCLASS)) < 0)
+    return -1;
+  for(i = 0; i < n; i++)
+    if(strcmp(st[i].name, name) == 0)
+      return st[i].maxwait;
+  return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, maxworkers, ticks, forkmode, total, w;
+  char *lock;
+
+  forkmode = 0;
+  if(argc > 1 && strcmp(argv[1], "-f") == 0){
+    forkmode = 1;
+    argc--;
+    argv++;
+  }
+  maxworkers = argc > 1 ? atoi(argv[1]) : 8;
+  ticks = argc > 2 ? atoi(argv[2]) : 10;
+  if(maxworkers < 1 || ticks < 1){
+    fprintf(2, "usage: lockbench [-f] [maxworkers] [ticks]\n");
+    exit(1);
+  }
+  lock = forkmode ? "wait_lock" : "kmem";
+
+  printf("lockbench: %s, %d ticks per round\n", forkmode ? "fork/wait" : "sbrk", ticks);
+  for(n = 1; n <= maxworkers; n++){
+    lockstat(LS_RESET, 0, 0);
+    total = round(n, ticks, forkmode);
+    w = maxwait(lock);
+    printf("workers %d: %d iterations/tick", n, total / ticks);
+    if(w >= 0)
+      printf(", %s maxwait %d", lock, w);
+    printf("\n");
+  }
+  exit(0);
+}
@@ -0,0 +1,93 @@
+// lockstat: report kernel lock contention.
+//
+//   lockstat              print the statistics collected so far
+//   lockstat -r           reset them
+//   lockstat cmd args...  reset, run cmd, then print
+//
+// The kernel must be built with "make LOCKSTAT=1".
+
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat st[NLOCKCLASS];
+
+// index of the histogram bucket holding the p-th percentile hold.
+int
+percentile(struct lockstat *s, int p)
+{
+  uint64 n, sum;
+  int i;
+
+  n = 0;
+  for(i = 0; i < NLSHIST; i++)
+    n += s->hold[i];
+  if(n == 0)
+    return 0;
+  sum = 0;
+  for(i = 0; i < NLSHIST; i++){
+    sum += s->hold[i];
+    if(sum * 100 >= n * p)
+      break;
+  }
+  return i;
+}
+
+void
+report(void)
+{
+  int i, n, max;
+  struct lockstat *s;
+
+  if((n = lockstat(LS_READ, st, NLOCKCLASS)) < 0){
+    fprintf(2, "lockstat: kernel built without LOCKSTAT\n");
+    exit(1);
+  }
+  printf("name             type  acquire contended spins maxwait  hold: p50 p99 max\n");
+  for(i = 0; i < n; i++){
+    s = &st[i];
+    if(s->nacquire == 0)
+      continue;
+    for(max = NLSHIST-1; max > 0 && s->hold[max] == 0; max--)
+      ;
+    // times are in time-CSR ticks (100ns in qemu), hold times as log2.
+    printf("%s", s->name);
+    for(int j = strlen(s->name); j < 17; j++)
+      printf(" ");
+    printf("%s %l %l %l %l  2^%d 2^%d 2^%d\n", s->sleep ? "sleep" : "spin ",
+           s->nacquire, s->ncontended, s->nspin, s->maxwait,
+           percentile(s, 50), percentile(s, 99), max);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc == 1){
+    report();
+    exit(0);
+  }
+
+  if(lockstat(LS_RESET, 0, 0) < 0){
+    fprintf(2, "lockstat: kernel built without LOCKSTAT\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "-r") == 0)
+    exit(0);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "lockstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  report();
+  exit(0);
+}
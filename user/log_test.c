@@ -1,5 +1,6 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/fcntl.h"
 #include "user/user.h"
 
 #define BUFFER_SIZE 4096  // One page size
@@ -53,7 +54,7 @@ int main(int argc, char *argv[]) {
     if(pid == 0) {
       // Child process
       // Map shared memory from parent
-      uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, BUFFER_SIZE);
+      uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, BUFFER_SIZE, PROT_READ|PROT_WRITE);
       
       if(shared_addr_child == 0) {
         exit(1);
@@ -239,7 +240,7 @@ int main(int argc, char *argv[]) {
     if(!found_new_message) {
       if(msg_count == last_msg_count) {
         no_progress_count++;
-        //sleep(1); // Short sleep to avoid busy waiting
+        nanosleep(100000); // Short sleep to avoid busy waiting
       } else {
         no_progress_count = 0;
         last_msg_count = msg_count;
@@ -0,0 +1,125 @@
+// mallocbench: malloc() and free() throughput.
+//
+//   mallocbench [ms]
+//
+// Each test runs for ms (default 2000) milliseconds and
+// reports operations (a malloc() and its free()) per second:
+//   pair N       malloc(N) then free() it at once;
+//   batch N      malloc(N) NBATCH times, then free them all in
+//                a scrambled order, which is hard on a free list
+//                kept in address order;
+//   mixed        NBATCH live blocks of sizes from 8 to 4096
+//                bytes, each in turn freed and replaced;
+//   arena N      arena_alloc(N) NBATCH times, then one
+//                arena_reset(), to compare with batch N.
+// At the end it frees everything and reports how much of the
+// heap was given back.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NBATCH 512
+
+void *p[NBATCH];
+struct arena arena;
+int ms;
+uint seed = 1;
+
+int sizes[] = { 16, 100, 1000, 8000 };
+
+uint
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+void*
+xmalloc(uint n)
+{
+  void *v;
+
+  if((v = malloc(n)) == 0){
+    fprintf(2, "mallocbench: out of memory\n");
+    exit(1);
+  }
+  return v;
+}
+
+int
+pair(int size, int unused)
+{
+  for(int i = 0; i < 64; i++)
+    free(xmalloc(size));
+  return 64;
+}
+
+int
+batch(int size, int unused)
+{
+  int i;
+
+  for(i = 0; i < NBATCH; i++)
+    p[i] = xmalloc(size);
+  // stride through the array: 37 is prime to NBATCH.
+  for(i = 0; i < NBATCH; i++)
+    free(p[(i * 37) % NBATCH]);
+  return NBATCH;
+}
+
+int
+mixed(int unused, int unused2)
+{
+  int i, j;
+
+  for(i = 0; i < 64; i++){
+    j = rnd() % NBATCH;
+    free(p[j]);
+    p[j] = xmalloc(8 + rnd() % 4089);
+  }
+  return 64;
+}
+
+int
+arenabatch(int size, int unused)
+{
+  for(int i = 0; i < NBATCH; i++){
+    if(arena_alloc(&arena, size) == 0){
+      fprintf(2, "mallocbench: out of memory\n");
+      exit(1);
+    }
+  }
+  arena_reset(&arena);
+  return NBATCH;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+  char *top0, *top1;
+
+  ms = argc > 1 ? atoi(argv[1]) : 2000;
+  if(ms < 1){
+    fprintf(2, "usage: mallocbench [ms]\n");
+    exit(1);
+  }
+
+  top0 = sbrk(0);
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    printf("pair %d: %l/s\n", sizes[i], benchrate(pair, sizes[i], 0, ms));
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    printf("batch %d: %l/s\n", sizes[i], benchrate(batch, sizes[i], 0, ms));
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    printf("arena %d: %l/s\n", sizes[i], benchrate(arenabatch, sizes[i], 0, ms));
+
+  for(i = 0; i < NBATCH; i++)
+    p[i] = xmalloc(8 + rnd() % 4089);
+  printf("mixed: %l/s\n", benchrate(mixed, 0, 0, ms));
+  top1 = sbrk(0);
+  for(i = 0; i < NBATCH; i++)
+    free(p[i]);
+  printf("heap: grew to %dK, %dK after freeing\n",
+         (int)(top1 - top0) / 1024, (int)(sbrk(0) - top0) / 1024);
+  exit(0);
+}
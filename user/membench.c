@@ -0,0 +1,94 @@
+// membench: memset/memmove/memcmp throughput.
+//
+//   membench [ms]
+//
+// Runs each routine on buffers of several sizes, aligned and
+// (for memmove and memcmp) with the source one byte off, for
+// ms (default 1000) milliseconds, and reports KB/second.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define MAXSIZE 65536
+
+char *a, *b;
+int ms;
+
+int sizes[] = { 16, 64, 256, 4096, MAXSIZE };
+
+// each returns the bytes it went through, 64 times n.
+int
+domemset(int n, int off)
+{
+  for(int i = 0; i < 64; i++)
+    memset(a + off, off, n);
+  return 64 * n;
+}
+
+int
+domemmove(int n, int off)
+{
+  for(int i = 0; i < 64; i++)
+    memmove(a, b + off, n);
+  return 64 * n;
+}
+
+int
+domemcmp(int n, int off)
+{
+  for(int i = 0; i < 64; i++){
+    // equal buffers, so every byte is compared.
+    if(memcmp(a, b + off, n) != 0){
+      fprintf(2, "membench: memcmp mismatch\n");
+      exit(1);
+    }
+  }
+  return 64 * n;
+}
+
+void
+run(char *name, int (*fn)(int, int), int off)
+{
+  int i;
+
+  printf("%s%s", name, off ? "+1" : "  ");
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    printf(" %l", benchrate(fn, sizes[i], off, ms) / 1024);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+  char *p;
+
+  ms = argc > 1 ? atoi(argv[1]) : 1000;
+  if(ms < 1){
+    fprintf(2, "usage: membench [ms]\n");
+    exit(1);
+  }
+  if((p = sbrk(2 * MAXSIZE + 16)) == (char*)-1){
+    fprintf(2, "membench: sbrk failed\n");
+    exit(1);
+  }
+  a = (char*)(((uint64)p + 7) & ~7L);
+  b = a + MAXSIZE + 8;
+  for(i = 0; i < MAXSIZE + 1; i++)
+    a[i] = b[i] = 'x';
+
+  printf("KB/s at sizes");
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    printf(" %d", sizes[i]);
+  printf("\n");
+  run("memset ", domemset, 0);
+  run("memset ", domemset, 1);
+  run("memmove", domemmove, 0);
+  run("memmove", domemmove, 1);
+  // memmove left a equal to b+1; make it equal to b again.
+  memmove(a, b, MAXSIZE);
+  run("memcmp ", domemcmp, 0);
+  memmove(a, b + 1, MAXSIZE);
+  run("memcmp ", domemcmp, 1);
+  exit(0);
+}
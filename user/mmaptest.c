@@ -0,0 +1,190 @@
+// mmaptest: tests for mmap() of files.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define FSIZE (2*PGSIZE + 100)   // a file ending part way into a page
+
+char *name = "mmaptest.tmp";
+char buf[FSIZE];
+
+void
+fail(char *msg)
+{
+  printf("%s\n", msg);
+  unlink(name);
+  exit(1);
+}
+
+// make the test file, byte i holding i % 251.
+void
+makefile(void)
+{
+  int fd, i;
+
+  for(i = 0; i < FSIZE; i++)
+    buf[i] = i % 251;
+  if((fd = open(name, O_CREATE|O_TRUNC|O_WRONLY)) < 0 || write(fd, buf, FSIZE) != FSIZE)
+    fail("cannot write test file");
+  close(fd);
+}
+
+// read the test file into buf.
+void
+readfile(void)
+{
+  int fd;
+
+  if((fd = open(name, O_RDONLY)) < 0 || read(fd, buf, FSIZE) != FSIZE)
+    fail("cannot read test file");
+  close(fd);
+}
+
+char*
+map(int mode, int off, int len, int prot, int flags)
+{
+  int fd;
+  char *p;
+
+  if((fd = open(name, mode)) < 0)
+    fail("cannot open test file");
+  p = mmap(fd, off, len, prot, flags);
+  // the mapping keeps the file open.
+  close(fd);
+  if(p == 0)
+    fail("mmap failed");
+  return p;
+}
+
+// the mapping holds the file, and zeros past its end.
+void
+readtest(void)
+{
+  char *p;
+  int i;
+
+  printf("read test: ");
+  makefile();
+  p = map(O_RDONLY, 0, FSIZE, PROT_READ, MAP_SHARED);
+  for(i = 0; i < FSIZE; i++)
+    if(p[i] != i % 251)
+      fail("wrong contents");
+  for(; i < 3*PGSIZE; i++)
+    if(p[i] != 0)
+      fail("not zero past the end of the file");
+  unmap_shared_pages(p, FSIZE);
+
+  p = map(O_RDONLY, PGSIZE, PGSIZE, PROT_READ, MAP_PRIVATE);
+  if(p[0] != PGSIZE % 251)
+    fail("wrong contents at an offset");
+  unmap_shared_pages(p, PGSIZE);
+  printf("OK\n");
+}
+
+// stores to a shared mapping reach the file, as does write();
+// a private mapping sees neither once it has its own copy.
+void
+writetest(void)
+{
+  char *s, *q;
+  int fd;
+
+  printf("write test: ");
+  makefile();
+  s = map(O_RDWR, 0, FSIZE, PROT_READ|PROT_WRITE, MAP_SHARED);
+  q = map(O_RDONLY, 0, FSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE);
+  q[1] = 'q';
+  s[PGSIZE + 1] = 's';
+  if(s[1] == 'q' || q[PGSIZE + 1] != 's')
+    fail("private mapping not copy-on-write");
+
+  if((fd = open(name, O_WRONLY)) < 0 || write(fd, "w", 1) != 1)
+    fail("cannot write test file");
+  close(fd);
+  if(s[0] != 'w' || q[0] != 0)
+    fail("write() not seen through the shared mapping only");
+
+  unmap_shared_pages(q, FSIZE);
+  unmap_shared_pages(s, FSIZE);
+  readfile();
+  if(buf[0] != 'w' || buf[1] != 1 || buf[PGSIZE + 1] != 's')
+    fail("wrong file contents after unmap");
+  printf("OK\n");
+}
+
+// a child shares a shared mapping and copies a private one,
+// and its stores are written back when it exits.
+void
+forktest(void)
+{
+  char *s, *q;
+  int xstatus;
+
+  printf("fork test: ");
+  makefile();
+  s = map(O_RDWR, 0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED);
+  q = map(O_RDWR, 0, PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE);
+  q[2] = 'p';
+  if(fork() == 0){
+    s[2] = 'c';
+    q[2] = 'c';
+    exit(q[2] == 'c' ? 0 : 1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || s[2] != 'c' || q[2] != 'p')
+    fail("wrong sharing after fork");
+  unmap_shared_pages(s, PGSIZE);
+  unmap_shared_pages(q, PGSIZE);
+
+  if(fork() == 0){
+    s = map(O_RDWR, 0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED);
+    s[3] = 'x';
+    exit(0);
+  }
+  wait(&xstatus);
+  readfile();
+  if(xstatus != 0 || buf[2] != 'c' || buf[3] != 'x')
+    fail("stores not written back");
+  printf("OK\n");
+}
+
+// bad arguments and permissions are refused.
+void
+errortest(void)
+{
+  int fd;
+
+  printf("error test: ");
+  makefile();
+  if((fd = open(name, O_RDONLY)) < 0)
+    fail("cannot open test file");
+  if(mmap(fd, 0, FSIZE, PROT_READ|PROT_WRITE, MAP_SHARED) != 0)
+    fail("writable shared mapping of a read-only file");
+  if(mmap(fd, 1, PGSIZE, PROT_READ, MAP_SHARED) != 0)
+    fail("unaligned offset accepted");
+  if(mmap(fd, 0, 4*PGSIZE, PROT_READ, MAP_SHARED) != 0)
+    fail("mapping past the end of the file accepted");
+  if(mmap(fd, 0, PGSIZE, PROT_READ, MAP_SHARED|MAP_PRIVATE) != 0)
+    fail("bad flags accepted");
+  close(fd);
+  if((fd = open(name, O_WRONLY)) < 0)
+    fail("cannot open test file");
+  if(mmap(fd, 0, PGSIZE, PROT_READ, MAP_SHARED) != 0)
+    fail("mapping of a write-only file");
+  close(fd);
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  readtest();
+  writetest();
+  forktest();
+  errortest();
+  unlink(name);
+  printf("ALL TESTS PASSED\n");
+  exit(0);
+}
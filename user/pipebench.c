@@ -0,0 +1,91 @@
+// pipebench: pipe bandwidth.
+//
+//   pipebench [-z] [megabytes]
+//
+// A child writes megabytes (default 4) into a pipe in chunks
+// of several sizes; the parent reads with the same chunk size
+// and reports the bandwidth of each run. With -z the child
+// uses vmsplice() on a page-aligned buffer, so that whole
+// pages move by reference, and only page-sized chunks are run.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define MAXCHUNK 32768
+
+char *buf;
+int zerocopy;
+
+int chunks[] = { 1, 64, 512, 4096, 32768 };
+
+void
+run(int chunk, int total)
+{
+  int fds[2], pid, n, got, t0, t;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  if((pid = fork()) < 0){
+    fprintf(2, "pipebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(n = 0; n < total; n += chunk){
+      if((zerocopy ? vmsplice(fds[1], buf, chunk) : write(fds[1], buf, chunk)) != chunk){
+        fprintf(2, "pipebench: write failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  got = 0;
+  while((n = read(fds[0], buf, chunk)) > 0)
+    got += n;
+  close(fds[0]);
+  wait(0);
+  t = uptime() - t0;
+  if(got != total)
+    printf("pipebench: chunk %d: short transfer %d of %d\n", chunk, got, total);
+  if(t == 0)
+    t = 1;
+  printf("chunk %d: %d KB in %d ticks, %d KB/tick\n", chunk, got / 1024, t, got / 1024 / t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, mb, total;
+  char *p;
+
+  if(argc > 1 && strcmp(argv[1], "-z") == 0){
+    zerocopy = 1;
+    argc--;
+    argv++;
+  }
+  mb = argc > 1 ? atoi(argv[1]) : 4;
+  if(mb < 1){
+    fprintf(2, "usage: pipebench [-z] [megabytes]\n");
+    exit(1);
+  }
+  if((p = sbrk(MAXCHUNK + 4096)) == (char*)-1){
+    fprintf(2, "pipebench: sbrk failed\n");
+    exit(1);
+  }
+  buf = (char*)(((uint64)p + 4095) & ~4095L);
+  memset(buf, 'x', MAXCHUNK);
+  for(i = 0; i < sizeof(chunks)/sizeof(chunks[0]); i++){
+    if(zerocopy && chunks[i] % 4096 != 0)
+      continue;
+    total = mb * 1024 * 1024;
+    // one-byte writes are slow enough that a sixteenth will do.
+    if(chunks[i] == 1)
+      total /= 16;
+    run(chunks[i], total);
+  }
+  exit(0);
+}
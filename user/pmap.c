@@ -0,0 +1,81 @@
+// pmap: report processes' memory and shared mappings.
+//
+//   pmap           every process
+//   pmap pid...    just these
+//
+// For each process: its heap (text, data, stack and sbrk
+// memory) and how much of it is still shared copy-on-write
+// after fork, its page-table pages, the pages it has mapped
+// in all and the most it has had since exec, then one line per shared
+// mapping with its protection now and at map time, its size,
+// the most and total references to its frames, and whether
+// it maps a file. A frame mapped by n processes has n
+// references, plus one if it is in the page cache. The summary adds
+// up all processes, so a frame two of them share counts twice.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/shminfo.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+struct shminfo si;
+int nproc, shmpages, ptpages;
+
+char*
+protstr(int prot)
+{
+  if(prot == PROT_NONE)
+    return "---";
+  return (prot & PROT_WRITE) ? "rw-" : "r--";
+}
+
+void
+report(void)
+{
+  struct shmseg *s;
+  int i;
+
+  printf("%d %s: heap %dK, %d pages mapped, %d copy-on-write; %d page-table pages; rss %dK, peak %dK",
+         si.pid, si.name, (int)(si.sz / 1024), si.heappages, si.cowpages, si.ptpages,
+         (si.heappages + si.shmpages) * (PGSIZE / 1024), si.peakpages * (PGSIZE / 1024));
+  if(si.nthread > 0)
+    printf("; %d threads", si.nthread);
+  printf("\n");
+  for(i = 0; i < si.nseg; i++){
+    s = &si.seg[i];
+    printf("  %p-%p %s/%s %d pages, refs max %d total %l%s\n", s->start, s->end,
+           protstr(s->prot), protstr(s->maxprot), s->npages, s->maxref, s->refs,
+           s->flags == MAP_SHARED ? ", file" : s->flags == MAP_PRIVATE ? ", file, private" : "");
+  }
+  nproc++;
+  shmpages += si.shmpages;
+  ptpages += si.ptpages;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, pid;
+
+  if(argc > 1){
+    for(i = 1; i < argc; i++){
+      pid = atoi(argv[i]);
+      if(pid <= 0 || shminfo(pid, &si) != pid){
+        fprintf(2, "pmap: no process %s\n", argv[i]);
+        exit(1);
+      }
+      report();
+    }
+    exit(0);
+  }
+
+  for(pid = 1; (pid = shminfo(pid, &si)) > 0; pid++)
+    report();
+  printf("%d processes: %d shared pages (%dK), %d page-table pages (%dK), %dK free\n",
+         nproc, shmpages, shmpages * PGSIZE / 1024, ptpages, ptpages * PGSIZE / 1024,
+         si.freepages * (PGSIZE / 1024));
+  exit(0);
+}
@@ -0,0 +1,245 @@
+// prof: sample where the CPUs spend their time.
+//
+//   prof cmd args...  sample while cmd runs, then print
+//   prof -s           start sampling
+//   prof -p           stop sampling and print
+//
+// Prints the functions that the most samples fell in, found
+// from /sym/kernel for kernel pcs and from /sym/prog for pcs
+// in a program prog. A CPU keeps NPROFSAMPLE samples, taken
+// HZ*PROFMULT times a second, so a long run drops the rest.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NTOP 20       // functions printed
+#define NPROG 16      // programs whose symbols are kept
+
+struct sym {
+  uint64 addr;
+  char *name;
+  int count;          // samples in this function
+};
+
+struct symtab {
+  char prog[16];      // program, or "kernel"
+  struct sym *sym;    // sorted by address
+  int n;
+};
+
+struct symtab tabs[NPROG];
+int ntab;
+struct profsample buf[256];
+
+int
+endswith(char *s, char *suffix)
+{
+  int n = strlen(s), m = strlen(suffix);
+
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// read file into a malloc()ed, nul-terminated buffer.
+char*
+readall(char *file)
+{
+  struct stat st;
+  char *p;
+  int fd, n, tot;
+
+  if((fd = open(file, O_RDONLY)) < 0)
+    return 0;
+  if(fstat(fd, &st) < 0 || (p = malloc(st.size + 1)) == 0){
+    close(fd);
+    return 0;
+  }
+  for(tot = 0; tot < st.size && (n = read(fd, p + tot, st.size - tot)) > 0; tot += n)
+    ;
+  close(fd);
+  p[tot] = 0;
+  return p;
+}
+
+// load the function symbols of file, lines of "address name"
+// as the Makefile writes them, into t.
+void
+load(struct symtab *t, char *file)
+{
+  char *p, *q, *name;
+  uint64 addr;
+  struct sym s;
+  int i, j, n, gap;
+
+  t->n = 0;
+  if((p = readall(file)) == 0)
+    return;
+  n = 1;
+  for(q = p; *q; q++)
+    if(*q == '\n')
+      n++;
+  if((t->sym = malloc(n * sizeof(struct sym))) == 0)
+    return;
+
+  while(*p){
+    addr = 0;
+    for(; *p && *p != ' ' && *p != '\n'; p++)
+      addr = addr * 16 + (*p >= 'a' ? *p - 'a' + 10 : *p - '0');
+    if(*p == ' ')
+      p++;
+    name = p;
+    while(*p && *p != '\n')
+      p++;
+    if(*p)
+      *p++ = 0;
+    // skip sections, local labels and source files.
+    if(name[0] == 0 || name[0] == '.' || name[0] == '$' ||
+       endswith(name, ".c") || endswith(name, ".S"))
+      continue;
+    t->sym[t->n].addr = addr;
+    t->sym[t->n].name = name;
+    t->sym[t->n].count = 0;
+    t->n++;
+  }
+
+  // shell sort by address.
+  for(gap = t->n / 2; gap > 0; gap /= 2){
+    for(i = gap; i < t->n; i++){
+      s = t->sym[i];
+      for(j = i; j >= gap && t->sym[j - gap].addr > s.addr; j -= gap)
+        t->sym[j] = t->sym[j - gap];
+      t->sym[j] = s;
+    }
+  }
+}
+
+// the symbol table for prog, loaded the first time.
+struct symtab*
+symtab(char *prog)
+{
+  struct symtab *t;
+  char file[32];
+
+  for(t = tabs; t < &tabs[ntab]; t++)
+    if(strcmp(t->prog, prog) == 0)
+      return t;
+  if(ntab == NPROG)
+    return 0;
+  t = &tabs[ntab++];
+  strcpy(t->prog, prog);
+  strcpy(file, "/sym/");
+  strcpy(file + strlen(file), prog);
+  load(t, file);
+  return t;
+}
+
+// the function holding pc: the symbol with the greatest
+// address not above it, or 0 if there is none.
+struct sym*
+lookup(struct symtab *t, uint64 pc)
+{
+  int lo, hi, mid;
+
+  if(t == 0 || t->n == 0 || pc < t->sym[0].addr)
+    return 0;
+  lo = 0;
+  hi = t->n - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(t->sym[mid].addr <= pc)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &t->sym[lo];
+}
+
+void
+report(int dropped)
+{
+  struct profsample *s;
+  struct symtab *t, *tk;
+  struct sym *top[NTOP], *sym;
+  char *where[NTOP];
+  int i, j, n, total, unknown;
+
+  tk = symtab("kernel");
+  total = unknown = 0;
+  while((n = prof(PROF_READ, buf, sizeof(buf)/sizeof(buf[0]))) > 0){
+    for(s = buf; s < &buf[n]; s++){
+      t = s->user ? symtab(s->name) : tk;
+      if((sym = lookup(t, s->pc)) != 0)
+        sym->count++;
+      else
+        unknown++;
+      total++;
+    }
+  }
+  if(n < 0){
+    fprintf(2, "prof: cannot read samples\n");
+    exit(1);
+  }
+
+  // the NTOP functions with the most samples, most first.
+  n = 0;
+  for(t = tabs; t < &tabs[ntab]; t++){
+    for(i = 0; i < t->n; i++){
+      sym = &t->sym[i];
+      if(sym->count == 0 || (n == NTOP && sym->count <= top[n-1]->count))
+        continue;
+      if(n < NTOP)
+        n++;
+      for(j = n - 1; j > 0 && top[j-1]->count < sym->count; j--){
+        top[j] = top[j-1];
+        where[j] = where[j-1];
+      }
+      top[j] = sym;
+      where[j] = t->prog;
+    }
+  }
+
+  printf("%d samples, %d dropped\n", total, dropped);
+  for(i = 0; i < n; i++)
+    printf("%d%% %d %s %s\n", top[i]->count * 100 / total, top[i]->count,
+           where[i], top[i]->name);
+  if(unknown)
+    printf("%d%% %d without symbols\n", unknown * 100 / total, unknown);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof cmd args... | prof -s | prof -p\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "-p") == 0){
+    report(prof(PROF_STOP, 0, 0));
+    exit(0);
+  }
+
+  if(prof(PROF_START, 0, 0) < 0){
+    fprintf(2, "prof: cannot start sampling\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "-s") == 0)
+    exit(0);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  report(prof(PROF_STOP, 0, 0));
+  exit(0);
+}
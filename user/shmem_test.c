@@ -1,5 +1,6 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/fcntl.h"
 #include "user/user.h"
 
 void print_size(char* label, int pid) {
@@ -38,7 +39,7 @@ int main(int argc, char *argv[])
     
     // Map shared memory from parent
     // We pass parent_pid, the virtual address in parent (buf_parent), and size
-    uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, 4096);
+    uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, 4096, PROT_READ|PROT_WRITE);
     
     // // Print the address returned by map_shared_pages for debugging
     // printf("Child: map_shared_pages returned: 0x%x\n", shared_addr_child);
@@ -1,5 +1,6 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/fcntl.h"
 #include "user/user.h"
 
 void print_size(char* label, int pid) {
@@ -43,7 +44,7 @@ int main(int argc, char *argv[])
       print_size("Child before mapping", getpid());
       
       // Map shared memory from parent
-      uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, 4096);
+      uint64 shared_addr_child = (uint64)map_shared_pages(parent_pid, buf_parent, 4096, PROT_READ|PROT_WRITE);
       
       printf("Child %d: map_shared_pages returned: 0x%x\n", i, shared_addr_child);
 
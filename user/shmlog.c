@@ -0,0 +1,102 @@
+// Multi-producer shared-memory log ring; see user/shmlog.h.
+
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/shmlog.h"
+
+// Set up a log in the bytes at mem, typically pages later
+// shared with the writers by map_shared_pages(). Returns the
+// log, or 0 if bytes is too small.
+struct shmlog*
+shmlog_init(void *mem, uint bytes)
+{
+  struct shmlog *lg = mem;
+  uint size;
+
+  if(bytes < sizeof(*lg) + 2*SHMLOG_HDR)
+    return 0;
+  for(size = SHMLOG_HDR; size * 2 <= bytes - sizeof(*lg); size *= 2)
+    ;
+  memset(lg, 0, sizeof(*lg) + size);
+  lg->size = size;
+  // a record may use at most half the ring, so that one
+  // long record cannot keep all others waiting.
+  lg->maxlen = size / 2 - SHMLOG_HDR;
+  return lg;
+}
+
+// copy n bytes between buf and the ring at offset off,
+// wrapping around its end, into the ring if toring is set.
+static void
+ringcopy(struct shmlog *lg, uint64 off, char *buf, int n, int toring)
+{
+  uint o = off & (lg->size - 1);
+  int m = n;
+
+  if(m > lg->size - o)
+    m = lg->size - o;
+  if(toring){
+    memmove(lg->data + o, buf, m);
+    memmove(lg->data, buf + m, n - m);
+  } else {
+    memmove(buf, lg->data + o, m);
+    memmove(buf + m, lg->data, n - m);
+  }
+}
+
+// Append len bytes from buf as a record from writer, waiting
+// for the reader if the ring is full. Returns 0, or -1 if the
+// record is too long.
+int
+shmlog_write(struct shmlog *lg, int writer, const void *buf, int len)
+{
+  uint64 pos, total;
+  int spins;
+
+  if(len < 0 || len > lg->maxlen)
+    return -1;
+  total = (SHMLOG_HDR + len + 7) & ~7L;
+  pos = __atomic_fetch_add(&lg->tail, total, __ATOMIC_RELAXED);
+  for(spins = 0; pos + total - __atomic_load_n(&lg->head, __ATOMIC_ACQUIRE) > lg->size; spins++){
+    // the reader may need this CPU to make room.
+    if(spins >= SHMLOG_SPINS)
+      nanosleep(SHMLOG_BACKOFF);
+  }
+  ringcopy(lg, pos + SHMLOG_HDR, (char*)buf, len, 1);
+  __atomic_store_n((uint64*)(lg->data + (pos & (lg->size - 1))),
+                   SHMLOG_COMMIT | (uint64)(uint16)writer << 32 | len,
+                   __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Take the next record, copying at most max bytes of it to
+// buf and its writer to *writer. Returns the record's length,
+// or -1 if the next record has not been committed yet.
+int
+shmlog_read(struct shmlog *lg, int *writer, void *buf, int max)
+{
+  uint64 pos, hdr, total;
+  uint o;
+  int len, m;
+
+  pos = lg->head;
+  hdr = __atomic_load_n((uint64*)(lg->data + (pos & (lg->size - 1))), __ATOMIC_ACQUIRE);
+  if((hdr & SHMLOG_COMMIT) == 0)
+    return -1;
+  len = hdr & 0xffffffff;
+  if(writer)
+    *writer = (hdr >> 32) & 0xffff;
+  ringcopy(lg, pos + SHMLOG_HDR, buf, len < max ? len : max, 0);
+
+  // zero the record, so that stale bytes never look like a
+  // committed header, then hand the space back.
+  total = (SHMLOG_HDR + len + 7) & ~7L;
+  o = pos & (lg->size - 1);
+  m = total;
+  if(m > lg->size - o)
+    m = lg->size - o;
+  memset(lg->data + o, 0, m);
+  memset(lg->data, 0, total - m);
+  __atomic_store_n(&lg->head, pos + total, __ATOMIC_RELEASE);
+  return len;
+}
@@ -0,0 +1,30 @@
+// A log of variable-length records in shared memory, written
+// by any number of processes at once and read by one.
+//
+// The ring is a power of two bytes long. A writer reserves
+// space for its record by advancing tail with fetch-and-add,
+// waits until the reader has released that space, copies the
+// record in, and finally stores its header with the commit
+// bit set. The reader consumes committed records in order from
+// head, zeroes them, and advances head so writers can reuse
+// the space. Records wrap around the end of the ring.
+
+struct shmlog {
+  uint size;      // bytes in data[], a power of two
+  uint maxlen;    // longest record payload
+  uint64 tail;    // bytes reserved by writers
+  uint64 head;    // bytes released by the reader
+  char data[];
+};
+
+// record header, one 8-byte word at an 8-byte aligned offset.
+#define SHMLOG_HDR     8
+#define SHMLOG_COMMIT  (1UL << 63)
+
+// a writer waiting for room spins this many times, then sleeps.
+#define SHMLOG_SPINS   1000
+#define SHMLOG_BACKOFF 100000  // nanoseconds it then sleeps between tries
+
+struct shmlog *shmlog_init(void *mem, uint bytes);
+int shmlog_write(struct shmlog *lg, int writer, const void *buf, int len);
+int shmlog_read(struct shmlog *lg, int *writer, void *buf, int max);
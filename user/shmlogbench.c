@@ -0,0 +1,104 @@
+// shmlogbench: shmlog throughput with several writers.
+//
+//   shmlogbench [maxwriters] [messages] [msglen]
+//
+// For 1, 2, 4, ... maxwriters (default 8) child processes,
+// each maps the parent's log with map_shared_pages() and
+// appends messages (default 2000) records of msglen (default
+// 32) bytes; the parent reads them all, checks that each
+// writer's records arrive in order, and reports the rate.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/shmlog.h"
+
+#define PGSIZE 4096
+#define LOGBYTES (4*PGSIZE)
+
+struct shmlog *lg;
+char msg[256];
+
+void
+writer(int parent, int w, int nmsg, int len)
+{
+  struct shmlog *l;
+  int i;
+
+  l = (struct shmlog*)map_shared_pages(parent, lg, LOGBYTES, PROT_READ|PROT_WRITE);
+  if(l == 0){
+    fprintf(2, "shmlogbench: map_shared_pages failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nmsg; i++){
+    *(int*)msg = i;
+    if(shmlog_write(l, w, msg, len) < 0){
+      fprintf(2, "shmlogbench: write failed\n");
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+void
+run(int nw, int nmsg, int len)
+{
+  int i, w, n, t0, t, got, parent;
+  int next[64];
+
+  parent = getpid();
+  t0 = uptime();
+  for(w = 0; w < nw; w++){
+    next[w] = 0;
+    if((i = fork()) < 0){
+      fprintf(2, "shmlogbench: fork failed\n");
+      exit(1);
+    }
+    if(i == 0)
+      writer(parent, w, nmsg, len);
+  }
+  for(got = 0; got < nw * nmsg; ){
+    if((n = shmlog_read(lg, &w, msg, sizeof(msg))) < 0)
+      continue;
+    if(n != len || w >= nw || *(int*)msg != next[w]){
+      printf("shmlogbench: bad record from writer %d: len %d seq %d\n", w, n, *(int*)msg);
+      exit(1);
+    }
+    next[w]++;
+    got++;
+  }
+  for(w = 0; w < nw; w++)
+    wait(0);
+  t = uptime() - t0;
+  if(t == 0)
+    t = 1;
+  printf("writers %d: %d records in %d ticks, %d records/tick, %d KB/tick\n",
+         nw, got, t, got / t, got / t * len / 1024);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nw, maxw, nmsg, len;
+  char *p;
+
+  maxw = argc > 1 ? atoi(argv[1]) : 8;
+  nmsg = argc > 2 ? atoi(argv[2]) : 2000;
+  len = argc > 3 ? atoi(argv[3]) : 32;
+  if(maxw < 1 || maxw > 64 || nmsg < 1 || len < sizeof(int) || len > sizeof(msg)){
+    fprintf(2, "usage: shmlogbench [maxwriters] [messages] [msglen]\n");
+    exit(1);
+  }
+  if((p = sbrk(LOGBYTES + PGSIZE)) == (char*)-1){
+    fprintf(2, "shmlogbench: sbrk failed\n");
+    exit(1);
+  }
+  p = (char*)(((uint64)p + PGSIZE - 1) & ~(PGSIZE - 1L));
+  if((lg = shmlog_init(p, LOGBYTES)) == 0){
+    fprintf(2, "shmlogbench: shmlog_init failed\n");
+    exit(1);
+  }
+  for(nw = 1; nw <= maxw; nw *= 2)
+    run(nw, nmsg, len);
+  exit(0);
+}
@@ -0,0 +1,243 @@
+// shmtest: tests for map_shared_pages() and friends.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/shminfo.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+char *buf;   // three page-aligned pages to share
+
+// Map one page of the parent's buffer.
+char*
+attach(int parent, int page)
+{
+  char *p = (char*)map_shared_pages(parent, buf + page*PGSIZE, PGSIZE, PROT_READ|PROT_WRITE);
+
+  if(p == 0){
+    printf("map_shared_pages failed\n");
+    exit(1);
+  }
+  return p;
+}
+
+// mappings can be undone in any order, and leave sbrk alone.
+void
+ordertest(void)
+{
+  char *m[3], *brk;
+  int i, parent = getpid();
+
+  printf("order test: ");
+  brk = sbrk(0);
+  for(i = 0; i < 3; i++)
+    m[i] = attach(parent, i);
+  if(sbrk(0) != brk){
+    printf("mapping moved the break\n");
+    exit(1);
+  }
+  for(i = 0; i < 3; i++){
+    if(m[i][0] != 'a' + i){
+      printf("page %d: wrong contents\n", i);
+      exit(1);
+    }
+  }
+  if(unmap_shared_pages(m[1], PGSIZE) < 0 || unmap_shared_pages(m[0], PGSIZE) < 0 ||
+     unmap_shared_pages(m[2], PGSIZE) < 0){
+    printf("unmap failed\n");
+    exit(1);
+  }
+  if(unmap_shared_pages(m[1], PGSIZE) == 0){
+    printf("unmapped twice\n");
+    exit(1);
+  }
+  // the heap still grows.
+  if(sbrk(10*PGSIZE) == (char*)-1){
+    printf("sbrk failed\n");
+    exit(1);
+  }
+  sbrk(-10*PGSIZE);
+  printf("OK\n");
+}
+
+// a forked child sees the same shared page, and it survives
+// the parent unmapping it.
+void
+forktest(void)
+{
+  char *m;
+  int pid, xstatus;
+
+  printf("fork test: ");
+  m = attach(getpid(), 0);
+  if((pid = fork()) == 0){
+    m[1] = 'c';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || buf[1] != 'c'){
+    printf("child's write not seen\n");
+    exit(1);
+  }
+  if((pid = fork()) == 0){
+    sleep(2);
+    exit(m[1] == 'p' ? 0 : 1);
+  }
+  m[1] = 'p';
+  unmap_shared_pages(m, PGSIZE);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("child lost the shared page\n");
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+// run fn in a child and return its exit status.
+int
+inchild(void (*fn)(char*), char *m)
+{
+  int xstatus;
+
+  if(fork() == 0){
+    fn(m);
+    exit(0);
+  }
+  wait(&xstatus);
+  return xstatus;
+}
+
+void
+store(char *m)
+{
+  m[0] = 'x';
+}
+
+void
+load(char *m)
+{
+  if(m[0] != 'a')
+    exit(1);
+}
+
+// a read-only mapping cannot be written, and mprotect() can
+// take permissions away but not grant more than the mapping
+// was made with.
+void
+protecttest(void)
+{
+  char *r, *w;
+  int parent = getpid();
+
+  printf("protect test: ");
+  if((r = (char*)map_shared_pages(parent, buf, PGSIZE, PROT_READ)) == 0){
+    printf("read-only map failed\n");
+    exit(1);
+  }
+  if(inchild(load, r) != 0){
+    printf("cannot read a read-only mapping\n");
+    exit(1);
+  }
+  if(inchild(store, r) != -1 || buf[0] != 'a'){
+    printf("wrote a read-only mapping\n");
+    exit(1);
+  }
+  if(mprotect(r, PGSIZE, PROT_READ|PROT_WRITE) == 0){
+    printf("mprotect granted write\n");
+    exit(1);
+  }
+  if(map_shared_pages(parent, buf, PGSIZE, 0x4) != 0){
+    printf("bad protection accepted\n");
+    exit(1);
+  }
+
+  w = attach(parent, 0);
+  if(mprotect(w, PGSIZE, PROT_NONE) < 0){
+    printf("mprotect failed\n");
+    exit(1);
+  }
+  if(inchild(load, w) != -1){
+    printf("read a PROT_NONE mapping\n");
+    exit(1);
+  }
+  if(mprotect(w, PGSIZE, PROT_READ|PROT_WRITE) < 0 || inchild(store, w) != 0 || buf[0] != 'x'){
+    printf("mprotect could not restore write\n");
+    exit(1);
+  }
+  buf[0] = 'a';
+  if(mprotect(buf, PGSIZE, PROT_READ) == 0){
+    printf("mprotect on the heap\n");
+    exit(1);
+  }
+  unmap_shared_pages(r, PGSIZE);
+  unmap_shared_pages(w, PGSIZE);
+  printf("OK\n");
+}
+
+// shminfo() sees the mapping, and the parent's reference to
+// its frame; the page counts follow sbrk() and the mapping,
+// and the peak stays put when they drop.
+void
+infotest(void)
+{
+  struct shminfo si;
+  char *m;
+  int pid = getpid(), heap, peak;
+
+  printf("info test: ");
+  if(shminfo(pid, &si) != pid || si.heappages != (si.sz + PGSIZE - 1) / PGSIZE ||
+     si.peakpages < si.heappages + si.shmpages){
+    printf("wrong page counts\n");
+    exit(1);
+  }
+  heap = si.heappages;
+  m = attach(pid, 0);
+  if(shminfo(pid, &si) != pid || si.nseg != 1 || si.shmpages != 1 ||
+     si.seg[0].start != (uint64)m || si.seg[0].maxref != 2 ||
+     si.seg[0].prot != (PROT_READ|PROT_WRITE) || si.heappages != heap){
+    printf("wrong shminfo\n");
+    exit(1);
+  }
+  unmap_shared_pages(m, PGSIZE);
+  if(shminfo(pid, &si) != pid || si.nseg != 0 || si.shmpages != 0){
+    printf("mapping still reported\n");
+    exit(1);
+  }
+
+  sbrk(8*PGSIZE);
+  if(shminfo(pid, &si) != pid || si.heappages != heap + 8 || si.peakpages < heap + 8){
+    printf("wrong counts after sbrk\n");
+    exit(1);
+  }
+  peak = si.peakpages;
+  sbrk(-8*PGSIZE);
+  if(shminfo(pid, &si) != pid || si.heappages != heap || si.peakpages != peak){
+    printf("wrong counts after shrinking\n");
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *p;
+  int i;
+
+  if((p = sbrk(4*PGSIZE)) == (char*)-1){
+    printf("sbrk failed\n");
+    exit(1);
+  }
+  buf = (char*)(((uint64)p + PGSIZE - 1) & ~(PGSIZE - 1L));
+  for(i = 0; i < 3; i++)
+    buf[i*PGSIZE] = 'a' + i;
+
+  ordertest();
+  forktest();
+  protecttest();
+  infotest();
+  printf("ALL TESTS PASSED\n");
+  exit(0);
+}
@@ -0,0 +1,44 @@
+// System call names, by number, for trace and sysstat.
+// Needs kernel/syscall.h.
+
+static char *sysname[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_map_shared_pages]   "map_shared",
+[SYS_unmap_shared_pages] "unmap_shared",
+[SYS_lockstat] "lockstat",
+[SYS_vmsplice] "vmsplice",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_clone]   "clone",
+[SYS_join]    "join",
+[SYS_mprotect] "mprotect",
+[SYS_shminfo] "shminfo",
+[SYS_mmap]    "mmap",
+[SYS_prof]    "prof",
+[SYS_trace]   "trace",
+[SYS_sysstat] "sysstat",
+[SYS_clock_gettime] "clock_gettime",
+[SYS_nanosleep] "nanosleep",
+};
+
+#define NSYS (sizeof(sysname)/sizeof(sysname[0]))
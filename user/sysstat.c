@@ -0,0 +1,93 @@
+// sysstat: count system calls and time them, like strace -c.
+//
+//   sysstat cmd args...  run cmd, then print the calls it and
+//                        its children made
+//   sysstat -p pid       print the calls pid has made so far
+//
+// For each system call, most time first: its share of the
+// time, calls, total and average microseconds, and how many
+// calls took less than 0.8us, 6.4us, ... 210ms, and longer.
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+#include "user/sysname.h"
+
+struct sysstat st[NSYSCALL];
+
+// times are in time-CSR ticks, 10 to the microsecond in qemu.
+void
+report(void)
+{
+  int order[NSYSCALL];
+  int i, j, n, k;
+  uint64 total;
+  struct sysstat *s;
+
+  // the calls made, by decreasing time.
+  n = 0;
+  total = 0;
+  for(i = 0; i < NSYSCALL; i++){
+    if(st[i].count == 0)
+      continue;
+    total += st[i].time;
+    for(j = n++; j > 0 && st[order[j-1]].time < st[i].time; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  printf("%%time calls total-us avg-us syscall  <0.8us <6.4us <51us <410us <3.3ms <26ms <210ms more\n");
+  for(i = 0; i < n; i++){
+    k = order[i];
+    s = &st[k];
+    printf("%d %d %l %l ", total ? (int)(s->time * 100 / total) : 0, s->count,
+           s->time / 10, s->time / s->count / 10);
+    if(k < NSYS && sysname[k])
+      printf("%s", sysname[k]);
+    else
+      printf("#%d", k);
+    for(j = 0; j < NSSHIST; j++)
+      printf(" %d", s->hist[j]);
+    printf("\n");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2 || (strcmp(argv[1], "-p") == 0 && argc != 3)){
+    fprintf(2, "usage: sysstat cmd args... | sysstat -p pid\n");
+    exit(1);
+  }
+
+  if(strcmp(argv[1], "-p") == 0){
+    if(sysstat(atoi(argv[2]), SS_SELF, st) < 0){
+      fprintf(2, "sysstat: no process %s\n", argv[2]);
+      exit(1);
+    }
+    report();
+    exit(0);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "sysstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "sysstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  // the child's counts passed to us when wait() reaped it.
+  if(sysstat(0, SS_CHILDREN, st) < 0){
+    fprintf(2, "sysstat: cannot read counts\n");
+    exit(1);
+  }
+  report();
+  exit(0);
+}
@@ -0,0 +1,89 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// threads: clone() and join() with a stack for each thread,
+// from malloc(), kept on a free list for the next one.
+//
+// A thread's stack is THREADSTACK bytes, with no unmapped
+// guard page below it: a thread that needs more writes over
+// the heap. So the stack's lowest words hold STACKMAGIC, and
+// thread_join() stops the program if they have changed.
+
+#define THREADSTACK 16384
+#define NGUARD 8
+#define STACKMAGIC 0x6b63617473646165UL
+
+struct threadstack {
+  struct threadstack *next;   // on the free list
+  uint64 guard[NGUARD];       // STACKMAGIC, unless overflowed
+  char stack[THREADSTACK];
+};
+
+static struct threadstack *freestacks;
+static struct mutex stacklock;
+
+// where every thread starts; returning from fn ends it.
+static void
+threadstart(void *arg)
+{
+  struct thread *t = arg;
+
+  t->ret = t->fn(t->arg);
+  exit(0);
+}
+
+// Run fn(arg) in a new thread, described by *t.
+// Returns 0, or -1 on failure.
+int
+thread_create(struct thread *t, void *(*fn)(void*), void *arg)
+{
+  struct threadstack *s;
+
+  // stacks are reused after thread_join().
+  mutex_lock(&stacklock);
+  if((s = freestacks) != 0)
+    freestacks = s->next;
+  mutex_unlock(&stacklock);
+  if(s == 0 && (s = malloc(sizeof(*s))) == 0)
+    return -1;
+  for(int i = 0; i < NGUARD; i++)
+    s->guard[i] = STACKMAGIC;
+
+  t->fn = fn;
+  t->arg = arg;
+  t->ret = 0;
+  t->stack = s;
+  t->tid = clone(threadstart, t, (void*)(((uint64)(s->stack + THREADSTACK)) & ~15L));
+  if(t->tid < 0){
+    mutex_lock(&stacklock);
+    s->next = freestacks;
+    freestacks = s;
+    mutex_unlock(&stacklock);
+    return -1;
+  }
+  return 0;
+}
+
+// Wait for thread t to finish, and set *ret to what it
+// returned. Returns 0, or -1 on failure.
+int
+thread_join(struct thread *t, void **ret)
+{
+  struct threadstack *s = t->stack;
+
+  if(join(t->tid) < 0)
+    return -1;
+  for(int i = 0; i < NGUARD; i++){
+    if(s->guard[i] != STACKMAGIC){
+      fprintf(2, "thread %d overflowed its %d-byte stack\n", t->tid, THREADSTACK);
+      exit(1);
+    }
+  }
+  if(ret)
+    *ret = t->ret;
+  mutex_lock(&stacklock);
+  s->next = freestacks;
+  freestacks = s;
+  mutex_unlock(&stacklock);
+  return 0;
+}
@@ -0,0 +1,176 @@
+// threadtest: tests for clone(), join() and the thread
+// library in thread.c and ulib.c.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NTHREAD 8
+#define NINCR 10000
+
+struct mutex lock;
+int counter;
+
+void*
+incr(void *arg)
+{
+  for(int i = 0; i < NINCR; i++){
+    mutex_lock(&lock);
+    counter++;
+    mutex_unlock(&lock);
+  }
+  return arg;
+}
+
+// threads share memory, and each gets back its own return value.
+void
+mutextest(void)
+{
+  struct thread t[NTHREAD];
+  void *ret;
+  int i;
+
+  printf("mutex test: ");
+  counter = 0;
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_create(&t[i], incr, (void*)(uint64)i) < 0){
+      printf("thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_join(&t[i], &ret) < 0 || ret != (void*)(uint64)i){
+      printf("thread_join %d failed\n", i);
+      exit(1);
+    }
+  }
+  if(counter != NTHREAD * NINCR){
+    printf("counter %d, expected %d\n", counter, NTHREAD * NINCR);
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+void*
+grow(void *arg)
+{
+  char *p;
+
+  for(int i = 0; i < 10; i++){
+    if((p = sbrk(4096)) == (char*)-1)
+      return (void*)1;
+    p[0] = p[4095] = 1;
+  }
+  return 0;
+}
+
+// threads growing memory at once get distinct pages.
+void
+sbrktest(void)
+{
+  struct thread t[NTHREAD];
+  void *ret;
+  int i;
+
+  printf("sbrk test: ");
+  for(i = 0; i < NTHREAD; i++)
+    if(thread_create(&t[i], grow, 0) < 0){
+      printf("thread_create failed\n");
+      exit(1);
+    }
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_join(&t[i], &ret) < 0 || ret != 0){
+      printf("thread %d failed\n", i);
+      exit(1);
+    }
+  }
+  printf("OK\n");
+}
+
+void*
+deep(void *arg)
+{
+  char buf[12*1024];
+
+  memset(buf, 1, sizeof(buf));
+  return (void*)(uint64)buf[sizeof(buf) - 1];
+}
+
+// a thread may use most of its stack, and reusing the stack
+// does not trip thread_join()'s overflow check.
+void
+stacktest(void)
+{
+  struct thread t;
+  void *ret;
+
+  printf("stack test: ");
+  for(int i = 0; i < 2; i++){
+    if(thread_create(&t, deep, 0) < 0 || thread_join(&t, &ret) < 0 || ret != (void*)1){
+      printf("deep thread failed\n");
+      exit(1);
+    }
+  }
+  printf("OK\n");
+}
+
+void*
+spin(void *arg)
+{
+  for(;;)
+    ;
+}
+
+// a process that exits takes its running threads with it,
+// and wait() does not see them.
+void
+exittest(void)
+{
+  struct thread t[2];
+  int pid, xstatus;
+
+  printf("exit test: ");
+  if((pid = fork()) == 0){
+    thread_create(&t[0], spin, 0);
+    thread_create(&t[1], spin, 0);
+    sleep(2);
+    exit(7);
+  }
+  if(wait(&xstatus) != pid || xstatus != 7){
+    printf("wait failed\n");
+    exit(1);
+  }
+  if(wait(0) != -1){
+    printf("wait saw a thread\n");
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+// join() only takes threads of the caller's process.
+void
+jointest(void)
+{
+  int pid;
+
+  printf("join test: ");
+  if((pid = fork()) == 0)
+    exit(0);
+  if(join(pid) != -1 || join(getpid()) != -1){
+    printf("join of a non-thread succeeded\n");
+    exit(1);
+  }
+  wait(0);
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  mutextest();
+  sbrktest();
+  stacktest();
+  exittest();
+  jointest();
+  printf("ALL TESTS PASSED\n");
+  exit(0);
+}
@@ -0,0 +1,298 @@
+// trace: record kernel events while a command runs.
+//
+//   trace [-v] [-e events] cmd args...
+//
+// events is a comma-separated list of sys (system calls),
+// sched (context switches), mem (page allocation), disk and
+// log (commits); the default is all but mem. Prints how many
+// of each kind there were and how long they took, in
+// microseconds; -v also prints every event.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+#include "user/sysname.h"
+
+#define NEV (NCPU*NTRACE)   // most events the rings can hold
+#define NPEND 64            // unfinished system calls, disk reads...
+#define RUNNABLE 3          // enum procstate, kernel/proc.h
+
+struct times {
+  int n;
+  uint64 total;
+  uint64 max;
+};
+
+// something started and not yet finished.
+struct pend {
+  uint64 key;         // pid or block number; 0 if free
+  uint64 time;
+  int what;
+};
+
+char *evname[NTREVENT] = {
+[TR_SYSENTER]    "sysenter",
+[TR_SYSEXIT]     "sysexit",
+[TR_SWITCHIN]    "switchin",
+[TR_SWITCHOUT]   "switchout",
+[TR_KALLOC]      "kalloc",
+[TR_KFREE]       "kfree",
+[TR_DISKSTART]   "diskstart",
+[TR_DISKDONE]    "diskdone",
+[TR_COMMITSTART] "commitstart",
+[TR_COMMITDONE]  "commitdone",
+};
+
+struct traceevent *ev;
+int nev;
+
+struct times sys[NSYS];
+struct times run, runnable, diskread, diskwrite, commit;
+int nkalloc, nkfree, nblocks;
+uint64 commitstart;
+
+struct pend syspend[NPEND], runpend[NPEND], diskpend[NPEND];
+struct pend oncpu[NCPU];
+
+// note that key started what at time.
+void
+start(struct pend *t, uint64 key, uint64 time, int what)
+{
+  struct pend *p, *free = 0;
+
+  for(p = t; p < &t[NPEND]; p++){
+    if(p->key == key){
+      free = p;
+      break;
+    }
+    if(p->key == 0 && free == 0)
+      free = p;
+  }
+  if(free){
+    free->key = key;
+    free->time = time;
+    free->what = what;
+  }
+}
+
+// the pending entry for key, removed, or 0 if there is none.
+struct pend*
+finish(struct pend *t, uint64 key)
+{
+  for(struct pend *p = t; p < &t[NPEND]; p++){
+    if(p->key == key){
+      p->key = 0;
+      return p;
+    }
+  }
+  return 0;
+}
+
+void
+add(struct times *s, uint64 t)
+{
+  s->n++;
+  s->total += t;
+  if(t > s->max)
+    s->max = t;
+}
+
+// read all the events and sort them by time.
+void
+readevents(void)
+{
+  struct traceevent e;
+  int n, i, j, gap;
+
+  if((ev = malloc(NEV * sizeof(struct traceevent))) == 0){
+    fprintf(2, "trace: out of memory\n");
+    exit(1);
+  }
+  while(nev < NEV && (n = trace(TRACE_READ, ev + nev, NEV - nev)) > 0)
+    nev += n;
+
+  // the rings are each in time order, but not with each other.
+  for(gap = nev / 2; gap > 0; gap /= 2){
+    for(i = gap; i < nev; i++){
+      e = ev[i];
+      for(j = i; j >= gap && ev[j - gap].time > e.time; j -= gap)
+        ev[j] = ev[j - gap];
+      ev[j] = e;
+    }
+  }
+}
+
+void
+tally(struct traceevent *e)
+{
+  struct pend *p;
+
+  switch(e->type){
+  case TR_SYSENTER:
+    start(syspend, e->pid, e->time, e->arg[0]);
+    break;
+  case TR_SYSEXIT:
+    if((p = finish(syspend, e->pid)) != 0 && p->what < NSYS)
+      add(&sys[p->what], e->time - p->time);
+    break;
+  case TR_SWITCHIN:
+    oncpu[e->cpu].key = e->arg[0];
+    oncpu[e->cpu].time = e->time;
+    if((p = finish(runpend, e->arg[0])) != 0)
+      add(&runnable, e->time - p->time);
+    break;
+  case TR_SWITCHOUT:
+    if(oncpu[e->cpu].key == e->arg[0])
+      add(&run, e->time - oncpu[e->cpu].time);
+    oncpu[e->cpu].key = 0;
+    if(e->arg[1] == RUNNABLE)
+      start(runpend, e->arg[0], e->time, 0);
+    break;
+  case TR_KALLOC:
+    nkalloc++;
+    break;
+  case TR_KFREE:
+    nkfree++;
+    break;
+  case TR_DISKSTART:
+    // key 0 means a free entry, so key on blockno+1.
+    start(diskpend, e->arg[0] + 1, e->time, e->arg[1]);
+    break;
+  case TR_DISKDONE:
+    if((p = finish(diskpend, e->arg[0] + 1)) != 0)
+      add(p->what ? &diskwrite : &diskread, e->time - p->time);
+    break;
+  case TR_COMMITSTART:
+    commitstart = e->time;    // commits don't overlap
+    nblocks += e->arg[0];
+    break;
+  case TR_COMMITDONE:
+    if(commitstart)
+      add(&commit, e->time - commitstart);
+    commitstart = 0;
+    break;
+  }
+}
+
+// times are in time-CSR ticks, 10 to the microsecond in qemu.
+void
+row(char *name, struct times *s)
+{
+  int i;
+
+  if(s->n == 0)
+    return;
+  printf("%s", name);
+  for(i = strlen(name); i < 14; i++)
+    printf(" ");
+  printf("%d %l %l\n", s->n, s->total / s->n / 10, s->max / 10);
+}
+
+void
+print(struct traceevent *e)
+{
+  printf("%l %d %d %s", e->time, e->cpu, e->pid,
+         e->type < NTREVENT && evname[e->type] ? evname[e->type] : "?");
+  if((e->type == TR_SYSENTER || e->type == TR_SYSEXIT) && e->arg[0] < NSYS && sysname[e->arg[0]])
+    printf(" %s", sysname[e->arg[0]]);
+  else
+    printf(" %l", e->arg[0]);
+  printf(" %l\n", e->arg[1]);
+}
+
+void
+report(int verbose, int dropped)
+{
+  int i;
+
+  readevents();
+  for(i = 0; i < nev; i++){
+    if(verbose)
+      print(&ev[i]);
+    tally(&ev[i]);
+  }
+
+  printf("%d events, %d dropped\n", nev, dropped);
+  printf("event         count avg-us max-us\n");
+  for(i = 0; i < NSYS; i++)
+    if(sysname[i])
+      row(sysname[i], &sys[i]);
+  row("[run]", &run);
+  row("[runnable]", &runnable);
+  row("[disk read]", &diskread);
+  row("[disk write]", &diskwrite);
+  row("[commit]", &commit);
+  if(commit.n)
+    printf("%d blocks committed\n", nblocks);
+  if(nkalloc || nkfree)
+    printf("%d pages allocated, %d freed\n", nkalloc, nkfree);
+}
+
+// the event types named in the comma-separated list s.
+int
+parsemask(char *s)
+{
+  char *e;
+  int mask = 0;
+
+  for(; *s; s = e){
+    for(e = s; *e && *e != ','; e++)
+      ;
+    if(e - s == 3 && memcmp(s, "sys", 3) == 0)
+      mask |= 1<<TR_SYSENTER | 1<<TR_SYSEXIT;
+    else if(e - s == 5 && memcmp(s, "sched", 5) == 0)
+      mask |= 1<<TR_SWITCHIN | 1<<TR_SWITCHOUT;
+    else if(e - s == 3 && memcmp(s, "mem", 3) == 0)
+      mask |= 1<<TR_KALLOC | 1<<TR_KFREE;
+    else if(e - s == 4 && memcmp(s, "disk", 4) == 0)
+      mask |= 1<<TR_DISKSTART | 1<<TR_DISKDONE;
+    else if(e - s == 3 && memcmp(s, "log", 3) == 0)
+      mask |= 1<<TR_COMMITSTART | 1<<TR_COMMITDONE;
+    else
+      return -1;
+    if(*e)
+      e++;
+  }
+  return mask;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, pid, verbose, mask;
+
+  verbose = 0;
+  mask = parsemask("sys,sched,disk,log");
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-v") == 0)
+      verbose = 1;
+    else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+      mask = parsemask(argv[++i]);
+    else
+      break;
+  }
+  if(i == argc || argv[i][0] == '-' || mask < 0){
+    fprintf(2, "usage: trace [-v] [-e sys,sched,mem,disk,log] cmd args...\n");
+    exit(1);
+  }
+
+  if(trace(TRACE_START, 0, mask) < 0){
+    fprintf(2, "trace: cannot start tracing\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "trace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[i], argv + i);
+    fprintf(2, "trace: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+  wait(0);
+  report(verbose, trace(TRACE_STOP, 0, 0));
+  exit(0);
+}
@@ -2,6 +2,7 @@
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
 #include "user/user.h"
+#include "kernel/param.h"
 
 //
 // wrapper so that it's OK if main() does not call exit().
@@ -47,10 +48,24 @@ void*
 memset(void *dst, int c, uint n)
 {
   char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uint64 w;
+
+  // fill the aligned middle 8 bytes at a time, 32 per loop.
+  if(n >= 16){
+    for(; (uint64)cdst & 7; n--)
+      *cdst++ = c;
+    w = (uchar)c * 0x0101010101010101UL;
+    for(; n >= 32; n -= 32, cdst += 32){
+      ((uint64*)cdst)[0] = w;
+      ((uint64*)cdst)[1] = w;
+      ((uint64*)cdst)[2] = w;
+      ((uint64*)cdst)[3] = w;
+    }
+    for(; n >= 8; n -= 8, cdst += 8)
+      *(uint64*)cdst = w;
   }
+  while(n-- > 0)
+    *cdst++ = c;
   return dst;
 }
 
@@ -111,15 +126,38 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  int words;
 
   dst = vdst;
   src = vsrc;
+  // equally aligned buffers move 8 bytes at a time.
+  words = n >= 16 && (((uint64)src ^ (uint64)dst) & 7) == 0;
   if (src > dst) {
+    if(words){
+      for(; (uint64)dst & 7; n--)
+        *dst++ = *src++;
+      for(; n >= 32; n -= 32, dst += 32, src += 32){
+        ((uint64*)dst)[0] = ((const uint64*)src)[0];
+        ((uint64*)dst)[1] = ((const uint64*)src)[1];
+        ((uint64*)dst)[2] = ((const uint64*)src)[2];
+        ((uint64*)dst)[3] = ((const uint64*)src)[3];
+      }
+      for(; n >= 8; n -= 8, dst += 8, src += 8)
+        *(uint64*)dst = *(const uint64*)src;
+    }
     while(n-- > 0)
       *dst++ = *src++;
   } else {
     dst += n;
     src += n;
+    if(words){
+      for(; (uint64)dst & 7; n--)
+        *--dst = *--src;
+      for(; n >= 8; n -= 8){
+        dst -= 8, src -= 8;
+        *(uint64*)dst = *(const uint64*)src;
+      }
+    }
     while(n-- > 0)
       *--dst = *--src;
   }
@@ -130,6 +168,15 @@ int
 memcmp(const void *s1, const void *s2, uint n)
 {
   const char *p1 = s1, *p2 = s2;
+  // skip equal aligned words; the byte loop below then
+  // finds the first difference.
+  if (n >= 16 && (((uint64)p1 ^ (uint64)p2) & 7) == 0) {
+    for (; (uint64)p1 & 7; n--, p1++, p2++)
+      if (*p1 != *p2)
+        return *p1 - *p2;
+    for (; n >= 8 && *(uint64*)p1 == *(uint64*)p2; n -= 8)
+      p1 += 8, p2 += 8;
+  }
   while (n-- > 0) {
     if (*p1 != *p2) {
       return *p1 - *p2;
@@ -145,3 +192,62 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// nanoseconds since boot, like clock_gettime() but read from
+// the time CSR, which the kernel lets user code read, so
+// without a system call.
+uint64
+nsecs(void)
+{
+  uint64 t;
+
+  asm volatile("csrr %0, time" : "=r" (t));
+  return t * NSPERTIME;
+}
+
+// The benchmarks' timing loop: call fn(a, b), which returns
+// how much work it did (operations, bytes), until ms
+// milliseconds have passed. Returns the work done per second.
+uint64
+benchrate(int (*fn)(int, int), int a, int b, int ms)
+{
+  uint64 t0, t, work;
+
+  work = 0;
+  t0 = nsecs();
+  do {
+    work += fn(a, b);
+  } while((t = nsecs()) - t0 < ms * 1000000ULL);
+  return work * 1000000 / ((t - t0) / 1000);
+}
+
+//
+// mutexes that sleep in futex_wait(). The threads that use
+// them are in thread.c, apart from this file so that programs
+// linked without malloc(), like forktest, can still use it.
+//
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c = 0;
+
+  if(__atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;
+  // mark the mutex contended, and sleep until it is free.
+  if(c != 2)
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1){
+    __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+    futex_wake(&m->state, 1);
+  }
+}
@@ -3,88 +3,297 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Small requests (up to 2048 bytes with the header) are
+// rounded up to one of NCLASS sizes, and each size has a
+// free list of blocks, so malloc() and free() of them take
+// constant time. A class's blocks are carved from 4096-byte
+// slabs, which stay in that class for good.
+//
+// Larger requests, and the slabs, come from a list of free
+// spans kept in address order, first fit, and coalesced when
+// freed. A free span that ends at the top of the heap and
+// has grown past TRIM bytes is handed back with a negative
+// sbrk(), keeping KEEP bytes for next time.
+//
+// Every block starts with a header giving its class, or its
+// size for a large one. A mutex makes it safe for threads.
+
+#define NCLASS  13
+#define SMALL   2048          // largest small block, header included
+#define SLAB    4096          // bytes carved into small blocks at once
+#define LARGE   NCLASS        // class of large blocks
+#define GROW    (16*4096)     // least the heap grows by
+#define TRIM    (32*4096)     // free top of heap that is given back
+#define KEEP    GROW          // and how much of it is kept
+#define MAXBYTES (1 << 30)    // largest request, so sizes fit an int
 
 typedef long Align;
 
+// 16 bytes, so that blocks, which start 16-byte aligned,
+// give 16-byte aligned memory.
 union header {
   struct {
-    union header *ptr;
-    uint size;
+    uint class;       // size class, or LARGE
+    uint size;        // bytes, header included, if LARGE
   } s;
-  Align x;
+  Align x[2];
 };
 
 typedef union header Header;
 
-static Header base;
-static Header *freep;
+// a free large block.
+struct span {
+  Header h;
+  struct span *next;  // next free span, at a higher address
+};
 
-void
-free(void *ap)
+// a free small block.
+struct block {
+  Header h;
+  struct block *next;
+};
+
+// the smallest holds a header and a free block's next pointer.
+static uint classsize[NCLASS] = {
+  32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+static uchar sizeclass[SMALL/16 + 1];   // class for each 16 bytes of size
+static struct block *freeblocks[NCLASS];
+static struct span *freespans;
+static struct mutex mlock;
+static int started;
+
+static void
+init(void)
 {
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  int c, i;
+  char *brk;
+
+  c = 0;
+  for(i = 0; i <= SMALL/16; i++){
+    while(classsize[c] < i*16)
+      c++;
+    sizeclass[i] = c;
+  }
+  // spans start 16-byte aligned.
+  brk = sbrk(0);
+  if((uint64)brk % 16)
+    sbrk(16 - (uint64)brk % 16);
+  started = 1;
 }
 
+// Put span s, of size bytes, on the free list, merging it
+// with its neighbours. Returns the merged span.
+// Called with mlock held.
+static struct span*
+freespan(struct span *s, uint size)
+{
+  struct span **pp, *prev, *next;
+
+  prev = 0;
+  for(pp = &freespans; *pp && *pp < s; pp = &(*pp)->next)
+    prev = *pp;
+  next = *pp;
+
+  s->h.s.class = LARGE;
+  s->h.s.size = size;
+  s->next = next;
+  *pp = s;
+  if(next && (char*)s + s->h.s.size == (char*)next){
+    s->h.s.size += next->h.s.size;
+    s->next = next->next;
+  }
+  if(prev && (char*)prev + prev->h.s.size == (char*)s){
+    prev->h.s.size += s->h.s.size;
+    prev->next = s->next;
+    s = prev;
+  }
+  return s;
+}
+
+// Give the kernel back most of free span s if it ends the
+// heap, that is, if nothing was sbrk()ed above it since.
+// Called with mlock held.
+static void
+trim(struct span *s)
+{
+  int n;
+
+  if(s->next == 0 && s->h.s.size >= TRIM && (char*)s + s->h.s.size == sbrk(0)){
+    n = (s->h.s.size - KEEP) & ~(4096 - 1);
+    if(sbrk(-n) != (char*)-1)
+      s->h.s.size -= n;
+  }
+}
+
+// Take size bytes, a multiple of 16, from the free spans,
+// growing the heap if need be. Called with mlock held.
 static Header*
-morecore(uint nu)
+allocspan(uint size)
 {
+  struct span **pp, *s;
+  uint n;
   char *p;
-  Header *hp;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
-    return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  for(;;){
+    for(pp = &freespans; (s = *pp) != 0; pp = &s->next){
+      if(s->h.s.size < size)
+        continue;
+      if(s->h.s.size - size >= sizeof(struct span)){
+        // the rest stays free, at the higher address.
+        *pp = (struct span*)((char*)s + size);
+        (*pp)->h.s.class = LARGE;
+        (*pp)->h.s.size = s->h.s.size - size;
+        (*pp)->next = s->next;
+      } else {
+        size = s->h.s.size;
+        *pp = s->next;
+      }
+      s->h.s.class = LARGE;
+      s->h.s.size = size;
+      return &s->h;
+    }
+
+    n = size > GROW ? (size + 4095) & ~4095 : GROW;
+    if((p = sbrk(n)) == (char*)-1)
+      return 0;
+    freespan((struct span*)p, n);
+  }
+}
+
+// Refill the free list of class c from a new slab.
+// Called with mlock held.
+static int
+refill(int c)
+{
+  char *p, *end;
+  struct block *b;
+  uint size = classsize[c];
+
+  if((p = (char*)allocspan(SLAB)) == 0)
+    return -1;
+  for(end = p + SLAB; p + size <= end; p += size){
+    b = (struct block*)p;
+    b->h.s.class = c;
+    b->next = freeblocks[c];
+    freeblocks[c] = b;
+  }
+  return 0;
+}
+
+void
+free(void *ap)
+{
+  Header *h;
+  struct block *b;
+
+  if(ap == 0)
+    return;
+  h = (Header*)ap - 1;
+  mutex_lock(&mlock);
+  if(h->s.class == LARGE){
+    trim(freespan((struct span*)h, h->s.size));
+  } else {
+    b = (struct block*)h;
+    b->next = freeblocks[h->s.class];
+    freeblocks[h->s.class] = b;
+  }
+  mutex_unlock(&mlock);
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  uint size;
+  int c;
+  struct block *b;
+  Header *h;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
-  }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
+  if(nbytes > MAXBYTES)
+    return 0;
+  size = (nbytes + sizeof(Header) + 15) & ~15;
+  mutex_lock(&mlock);
+  if(!started)
+    init();
+  if(size <= SMALL){
+    c = sizeclass[size/16];
+    if(freeblocks[c] == 0 && refill(c) < 0){
+      mutex_unlock(&mlock);
+      return 0;
     }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+    b = freeblocks[c];
+    freeblocks[c] = b->next;
+    h = &b->h;
+  } else if((h = allocspan(size)) == 0){
+    mutex_unlock(&mlock);
+    return 0;
+  }
+  mutex_unlock(&mlock);
+  return (void*)(h + 1);
+}
+
+//
+// arenas: memory handed out by bumping a pointer through
+// chunks from malloc(), all freed at once by arena_reset().
+// Quicker than malloc() for many small objects that die
+// together. An arena is for one thread at a time.
+//
+
+#define ARENACHUNK 4096
+
+struct arenachunk {
+  struct arenachunk *next;
+  uint size;                // bytes, this header included
+};
+
+// Return n bytes from a, 8-byte aligned, or 0.
+void*
+arena_alloc(struct arena *a, uint n)
+{
+  struct arenachunk *c;
+  uint size;
+  char *p;
+
+  n = (n + 7) & ~7;
+  if(a->next == 0 || a->end - a->next < n){
+    size = sizeof(*c) + n;
+    if(size < ARENACHUNK)
+      size = ARENACHUNK;
+    if((c = malloc(size)) == 0)
+      return 0;
+    c->next = a->chunks;
+    c->size = size;
+    a->chunks = c;
+    a->next = (char*)(c + 1);
+    a->end = (char*)c + size;
+  }
+  p = a->next;
+  a->next += n;
+  return p;
+}
+
+// Free everything allocated from a, but keep its newest
+// chunk, if an ordinary one, to start again with.
+void
+arena_reset(struct arena *a)
+{
+  struct arenachunk *c, *next;
+
+  c = a->chunks;
+  if(c && c->size == ARENACHUNK){
+    next = c->next;
+    c->next = 0;
+    a->next = (char*)(c + 1);
+    a->end = (char*)c + ARENACHUNK;
+    c = next;
+  } else {
+    a->chunks = 0;
+    a->next = a->end = 0;
+  }
+  for(; c; c = next){
+    next = c->next;
+    free(c);
   }
 }
@@ -1,4 +1,11 @@
 struct stat;
+struct lockstat;
+struct shminfo;
+struct profsample;
+struct traceevent;
+struct sysstat;
+struct threadstack;
+struct arenachunk;
 
 // system calls
 int fork(void);
@@ -22,8 +29,22 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-uint64 map_shared_pages(int pid, void *addr, uint size);
+uint64 map_shared_pages(int pid, void *addr, uint size, int prot);
 int unmap_shared_pages(void *addr, uint size);
+int lockstat(int op, struct lockstat*, int n);
+int vmsplice(int, const void*, int);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+int clone(void (*)(void*), void*, void*);
+int join(int);
+int mprotect(void*, int, int);
+int shminfo(int, struct shminfo*);
+void* mmap(int fd, int off, int len, int prot, int flags);
+int prof(int op, struct profsample*, int n);
+int trace(int op, struct traceevent*, int n);
+int sysstat(int pid, int who, struct sysstat*);
+uint64 clock_gettime(void);
+int nanosleep(uint64 ns);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -41,3 +62,31 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+uint64 nsecs(void);
+uint64 benchrate(int (*)(int, int), int, int, int);
+
+// thread.c and ulib.c: threads and mutexes. A thread has a
+// 16K stack, which thread_join() checks it did not overflow.
+struct thread {
+  int tid;
+  void *(*fn)(void*);
+  void *arg;
+  void *ret;                // what fn returned
+  struct threadstack *stack;
+};
+struct mutex {
+  int state;                // 0 unlocked, 1 locked, 2 locked with waiters
+};
+int thread_create(struct thread*, void *(*)(void*), void*);
+int thread_join(struct thread*, void**);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+
+// umalloc.c arenas
+struct arena {
+  struct arenachunk *chunks;  // newest first
+  char *next;                 // next free byte in chunks
+  char *end;                  // end of chunks
+};
+void *arena_alloc(struct arena*, uint);
+void arena_reset(struct arena*);
@@ -2571,6 +2571,30 @@ badarg(char *s)
   exit(0);
 }
 
+// nanosleep() sleeps at least as long as asked, and much
+// less than a clock tick; the two clocks agree.
+void
+nanosleeptest(char *s)
+{
+  uint64 t0, t1, t2;
+
+  t0 = nsecs();
+  if(nanosleep(2000000) < 0){
+    printf("%s: nanosleep failed\n", s);
+    exit(1);
+  }
+  t1 = clock_gettime();
+  t2 = nsecs();
+  if(t1 - t0 < 2000000 || t1 - t0 > 50000000){
+    printf("%s: nanosleep(2ms) took %l ns\n", s, t1 - t0);
+    exit(1);
+  }
+  if(t2 < t1){
+    printf("%s: nsecs() behind clock_gettime()\n", s);
+    exit(1);
+  }
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2635,6 +2659,7 @@ struct test {
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
   {badarg, "badarg" },
+  {nanosleeptest, "nanosleep" },
 
   { 0, 0},
 };
@@ -37,4 +37,18 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("map_shared_pages");
-entry("unmap_shared_pages");
\ No newline at end of file
+entry("unmap_shared_pages");
+entry("lockstat");
+entry("vmsplice");
+entry("futex_wait");
+entry("futex_wake");
+entry("clone");
+entry("join");
+entry("mprotect");
+entry("shminfo");
+entry("mmap");
+entry("prof");
+entry("trace");
+entry("sysstat");
+entry("clock_gettime");
+entry("nanosleep");
\ No newline at end of file